@@ -15,40 +15,17 @@
 #include <condition_variable>
 #include <thread> 
 #include <chrono>
-#include <random>
+
+#include "../../Common/FastRand.h"
 
 using namespace std;
 
 #define WAIT_FOR_THREAD(r) if ((r)->joinable()) (r)->join();
 
-class UniformRandInt
-{
-public:
-	void Init(int min, int max)
-	{
-		// Seed our random number generator with a non-deterministic random value. If no such capabilities exist then
-		//   the number will be pulled from a pseudo random number generator.
-		randEngine.seed(randDevice());
-
-		// We want to generate values in the range of [min, max] (inclusive) with a uniform distribution.
-		distro = std::uniform_int_distribution<int>(min, max);
-	}
-
-	int operator()()
-	{
-		return distro(randEngine);
-	}
-
-private:
-	std::random_device randDevice;
-	std::mt19937 randEngine;
-	std::uniform_int_distribution<int> distro;
-};
-
 struct ThreadStruct
 {
 	int id;									// thread number
-	UniformRandInt myRand;					// random number generator for this thread
+	FastRand myRand;						// random number generator for this thread
 	
 	std::mutex* Mutex;
 	std::mutex* conditionMutex;
@@ -88,7 +65,7 @@ void JoinableThreadEntrypoint(ThreadStruct *threadData)
 
 	std::thread waitThread = std::thread(WorkDelay, std::ref(Promeise), threadData);
 
-	int workLimit = (threadData->id + 1) + (threadData->myRand());
+	int workLimit = (threadData->id + 1) + threadData->myRand.Range(0, 100);
 	int work = 0;
 
 	// Performs some arbitrary amount of work.
@@ -117,7 +94,7 @@ void DetachedThreadEntrypoint(ThreadStruct *threadData)
 	std::thread waitThread = std::thread(WorkDelay, std::ref(Promeise), threadData);
 
 
-	int workLimit = (threadData->id + 1) + (threadData->myRand());
+	int workLimit = (threadData->id + 1) + threadData->myRand.Range(0, 100);
 	int work = 0;
 
 	printf("START: Detached Thread %d, starting limit = %d\n", threadData->id, workLimit);
@@ -188,10 +165,13 @@ int main(int argc, char **argv)
 	std::mutex threMutex = std::mutex();
 	bool myFlag = false;
 
+	// One device read seeds every thread's generator
+	FastRand seeds(FastRand::DeviceSeed());
+
 	for(int i = totalThreadCount - 1; i >= 0; i--)
 	{		
 		perThreadData[i].id = i;
-		perThreadData[i].myRand.Init(0, 100);
+		perThreadData[i].myRand.Seed(seeds());
 
 		perThreadData[i].detachNumber = &number;
 		perThreadData[i].cv = &myCV;
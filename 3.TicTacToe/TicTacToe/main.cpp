@@ -15,39 +15,99 @@
 #include <condition_variable>
 #include <thread> 
 #include <chrono>
-#include <random>
+#include <atomic>
+#include <algorithm>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
+
+#include "../../Common/FastRand.h"
 
 using namespace std;
 
 
 #define WAIT_FOR_THREAD(r) if ((r)->joinable()) (r)->join();
 
-class UniformRandInt
-{
-public:
-	void Init(int min, int max)
+// Bit counting for the bitboards. SelectBit returns the bit of the n-th set bit
+//   (from 0), with a single pdep where BMI2 is available.
+#if defined _MSC_VER
+	#include <intrin.h>
+	#if defined __AVX2__
+		#include <immintrin.h>
+	#endif
+	static int CountBits(unsigned bits)
 	{
-		// Seed our random number generator with a non-deterministic random value. If no such capabilities exist then
-		//   the number will be pulled from a pseudo random number generator.
-		randEngine.seed(randDevice());
-
-		// We want to generate values in the range of [min, max] (inclusive) with a uniform distribution.
-		distro = std::uniform_int_distribution<int>(min, max);
+		return (int)__popcnt(bits);
+	}
+	static int CountTrailingZeros(unsigned bits)
+	{
+		unsigned long index;
+		_BitScanForward(&index, bits);
+		return (int)index;
+	}
+#else
+	#if defined __BMI2__
+		#include <immintrin.h>
+	#endif
+	static int CountBits(unsigned bits)
+	{
+		return __builtin_popcount(bits);
 	}
+	static int CountTrailingZeros(unsigned bits)
+	{
+		return __builtin_ctz(bits);
+	}
+#endif
+
+// SIMD game kernels. SSE2 is always there on x64, AVX2 only when the compiler 
+//   targets it.
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+	#define HAS_SSE2_KERNELS
+	#include <emmintrin.h>
+#endif
+#if defined __AVX2__
+	#define HAS_AVX2_KERNELS
+	#include <immintrin.h>
+#endif
 
-	int operator()()
+#if defined __BMI2__ || (defined _MSC_VER && defined __AVX2__)
+	static unsigned SelectBit(unsigned bits, int n)
+	{
+		return _pdep_u32(1u << n, bits);
+	}
+#else
+	static unsigned SelectBit(unsigned bits, int n)
 	{
-		return distro(randEngine);
+		for (int i = 0; i < n; i++)
+		{
+			bits &= bits - 1;
+		}
+		return bits & (0u - bits);
 	}
+#endif
 
-private:
-	std::random_device randDevice;
-	std::mt19937 randEngine;
-	std::uniform_int_distribution<int> distro;
-	std::mutex randMutex;
-};
+// Every cell of the board, bit (row * 3) + col is the cell at row, col
+const unsigned AllCells = 0x1FF;
+
+// The three rows, the three columns and the two diagonals
+const unsigned WinLines[8] = { 0x007, 0x038, 0x1C0, 0x049, 0x092, 0x124, 0x111, 0x054 };
+
+// Per set of cells, true if it holds a whole line. Filled in by InitWinningCells.
+bool WinningCells[AllCells + 1];
+
+// Number of positions with each cell free, X or O, most of which no game reaches
+const int PositionTableSize = 19683;
+
+// Marks a position in PositionValues that no game reaches
+const signed char UnsolvedPosition = 2;
+
+// The value of each position for the player to move, 1 for a forced win, 0 for a
+//   draw and -1 for a forced loss. Indexed by PositionIndex and filled in by
+//   InitPositionValues.
+signed char PositionValues[PositionTableSize];
+
+// Per set of cells, the sum of 3^cell over its cells. Filled in by InitPositionValues.
+unsigned short Base3Cells[AllCells + 1];
 
 ///////////////////////////////////////////////////////////////////////////////////
 // The various states the game can be in
@@ -69,6 +129,22 @@ enum class PlayerType
 	O
 };
 
+///////////////////////////////////////////////////////////////////////////////////
+// How a player picks its moves
+///////////////////////////////////////////////////////////////////////////////////
+enum class PlayerStrategy
+{
+	// Any free cell
+	Random,
+	// The best move, read from PositionValues
+	Perfect,
+	// The best move, found by a negamax search without the table
+	Search
+};
+
+// Names of the strategies, in the order of PlayerStrategy
+const char *StrategyNames[] = { "random", "perfect", "search" };
+
 ///////////////////////////////////////////////////////////////////////////////////
 // Various types of operations that can be performed on our synchronization object
 //   via LogSync.
@@ -90,8 +166,6 @@ enum class LogSyncOperation
 ///////////////////////////////////////////////////////////////////////////////////
 struct Game
 {
-	// Number of players that are currently playing in this game
-	int playerCount;
 	// ID of the game
 	int gameNumber;
 	// Determines which player is currently playing
@@ -102,8 +176,6 @@ struct Game
 	int playerX;
 	// Thread ID of the O player or -1 if O player doesn't exist for this game
 	int playerO;
-	// Mutex to access playerCount in a thread safe manner.
-	std::mutex playerCountMutex;
 	// Primary mutex that controls the game play. The player that has this mutex locked
 	//  will be playing, while the other player will be waiting on the gameCondition.
 	std::mutex gameMutex;
@@ -112,9 +184,10 @@ struct Game
 	// Unique lock which will be constructed with the gameMutex. This will ONLY be valid in
 	//  the PlayGame function.
 	std::unique_lock<std::mutex> *gameUniqueLock;
-	// A 3x3 array of PlayerTypes that represents the game board. Each entry will represent
-	//  which player currently owns that spot or 'None' if the spot is not taken.
-	PlayerType gameBoard[3][3];
+	// The game board as two bitboards, the cells X has taken and the cells O has taken.
+	//  Bit (row * 3) + col is the cell at row, col. A cell in neither is free.
+	unsigned short xCells;
+	unsigned short oCells;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////
@@ -134,12 +207,21 @@ struct Player
 	int drawCount;
 	// Type of player this player represents
 	PlayerType type;
+	// How this player picks its moves
+	PlayerStrategy strategy;
 	// Pointer to the pool of games. See GamePool for more details.
 	struct GamePool *gamePool;
 	// Pointer to the pool of players. See PlayerPool for more details.
 	struct PlayerPool *playerPool;
 	// random number generator for this thread
-	UniformRandInt myRand;
+	FastRand myRand;
+	// Index of the game the matcher put this player in, NoGameAssigned while it 
+	//   waits or NoGamesLeft once every game has been handed out.
+	int assignedGame;
+	// Mutex to access assignedGame in a thread safe manner.
+	std::mutex matchMutex;
+	// The condition variable the player waits on until the matcher assigns it a game.
+	std::condition_variable matchCondition;
 	//MY VARIABLES
 	int* ready;
 	std::mutex* count;
@@ -158,16 +240,124 @@ struct GamePool
 	Game *perGameData;
 	// Total number of games and the number of entries in perGameData
 	int totalGameCount;
+	// When the starting gun was fired.
+	std::chrono::steady_clock::time_point gunFired;
+	// Microseconds from the starting gun to the first move of any game, or -1 before
+	//   the first move.
+	std::atomic<long long> firstMoveTime;
+	// Index of the first game of the next batch to hand out in batch mode.
+	std::atomic<int> nextBatch;
+};
+
+// Number of games a batch worker claims at a time and plays side by side
+const int BatchSize = 64;
+
+///////////////////////////////////////////////////////////////////////////////////
+// Games stored as a structure of arrays, one contiguous array per field, so the
+//   game kernels can load the same field of 8 or 16 games at once. Used by the
+//   simd mode in place of the Game structs.
+///////////////////////////////////////////////////////////////////////////////////
+struct GameStore
+{
+	// Number of games in each array, a multiple of BatchSize
+	int count;
+	// The cells X has taken in each game
+	unsigned short *xCells;
+	// The cells O has taken in each game
+	unsigned short *oCells;
+	// Whose move it is in each game, 0 for X and 1 for O
+	unsigned short *turn;
+	// The GameState of each game
+	unsigned short *state;
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+// One implementation of the game kernels. Each works on a run of games starting
+//   at a multiple of 16, with a count that is a multiple of 16.
+///////////////////////////////////////////////////////////////////////////////////
+struct GameKernel
+{
+	// Name printed by the benchmark
+	const char *name;
+	// Makes a random move in every game still being played. Every four games use 
+	//   one draw of the generator whether they are played or not, so each kernel
+	//   makes the same moves from the same seed.
+	void (*applyRandomMoves)(GameStore *store, int first, int count, FastRand *rand);
+	// Checks the eight lines of whoever just moved and marks games that were 
+	//   won or drawn.
+	void (*evaluateGames)(GameStore *store, int first, int count);
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+// Contains all data for one batch mode worker. A worker isn't a player, it plays
+//   both sides of every game in the batches it claims.
+///////////////////////////////////////////////////////////////////////////////////
+struct BatchWorker
+{
+	// ID of the worker
+	int id;
+	// Number of games this worker has played
+	int gamesPlayed;
+	// Total number of players the games are split between
+	int totalPlayerCount;
+	// Pointer to the pool of games. See GamePool for more details.
+	GamePool *gamePool;
+	// The simd mode's copy of the games, or nullptr to play the Game structs.
+	GameStore *store;
+	// The kernels used on the store
+	const GameKernel *kernel;
+	// random number generator for this thread
+	FastRand myRand;
+};
+
+// Values of Player::assignedGame that aren't a game index
+const int NoGameAssigned = -1;
+const int NoGamesLeft = -2;
+
+///////////////////////////////////////////////////////////////////////////////////
+// One entry in the matchmaking queue. The sequence number tells producers and 
+//   consumers whose turn the slot is, so no slot is ever locked.
+///////////////////////////////////////////////////////////////////////////////////
+struct MatchSlot
+{
+	// Equal to the position of the next enqueue that may write the slot, or that
+	//   position + 1 once it has been written and may be dequeued.
+	std::atomic<unsigned> sequence;
+	// ID of the queued player.
+	int playerId;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////
-// This structure is provided to store data for keeping track of the total number
-//   of player threads in a thread-safe manner and implementing the starting gun
-//   logic.
+// Matchmaking for the players. A player that wants a game pushes its ID onto a 
+//   bounded lock-free MPMC queue. The matcher thread pops players two at a time and
+//   hands each pair the next game nobody has played yet, so no player ever looks at
+//   a game it won't play.
 ///////////////////////////////////////////////////////////////////////////////////
 struct PlayerPool
 { 
-
+	// Total number of players and the number of entries in perPlayerData
+	int totalPlayerCount;
+	// An array of player specific data with exactly one entry for each player.
+	struct Player *perPlayerData;
+	// The pool of games the matcher hands out.
+	GamePool *gamePool;
+	// The queue of players waiting for a game. Its size is a power of 2 and at least
+	//   the number of players, since a player is never queued twice, so it never fills.
+	MatchSlot *slots;
+	// Number of slots - 1, to turn a position into a slot index.
+	unsigned slotMask;
+	// Position of the next enqueue.
+	std::atomic<unsigned> enqueuePosition;
+	// Position of the next dequeue.
+	std::atomic<unsigned> dequeuePosition;
+	// Index of the next game to hand out. Only the matcher touches it.
+	int nextGame;
+	// True while the matcher waits on the matcherCondition for the queue to fill.
+	std::atomic<bool> matcherWaiting;
+	// Mutex used with the matcherCondition.
+	std::mutex matcherMutex;
+	// The condition variable the matcher waits on while nobody is queued.
+	std::condition_variable matcherCondition;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////
@@ -249,6 +439,285 @@ int Log(const char *format, ...)
 	return result;
 }
 
+///////////////////////////////////////////////////////////////////////////////////
+// Checks the eight lines one by one.
+//
+// Arguments:
+//   cells - The cells one player has taken
+//
+// Return:
+//   True if the cells hold a whole row, column or diagonal
+///////////////////////////////////////////////////////////////////////////////////
+bool HasWinningLine(unsigned cells)
+{
+	bool won = false;
+	for (int i = 0; i < 8; i++)
+	{
+		won |= (cells & WinLines[i]) == WinLines[i];
+	}
+	return won;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Fills in the WinningCells table for every one of the 512 sets of cells. Must be
+//   called before any game is played.
+///////////////////////////////////////////////////////////////////////////////////
+void InitWinningCells()
+{
+	for (unsigned cells = 0; cells <= AllCells; cells++)
+	{
+		WinningCells[cells] = HasWinningLine(cells);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Gets the cells of a game nobody has taken.
+//
+// Arguments:
+//   game - The game
+//
+// Return:
+//   The free cells
+///////////////////////////////////////////////////////////////////////////////////
+unsigned FreeCells(const Game *game)
+{
+	return ~(game->xCells | game->oCells) & AllCells;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Picks one of a set of cells with every cell equally likely.
+//
+// Arguments:
+//   cells - The cells to pick from, at least one
+//   rand - The random number generator to use
+//
+// Return:
+//   The bit of the cell picked
+///////////////////////////////////////////////////////////////////////////////////
+unsigned PickRandomCell(unsigned cells, FastRand *rand)
+{
+	return SelectBit(cells, (int)rand->Bounded(CountBits(cells)));
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Gets the index of a position in PositionValues, each cell a base 3 digit that is
+//   0 when free, 1 for X and 2 for O.
+//
+// Arguments:
+//   xCells - The cells X has taken
+//   oCells - The cells O has taken
+//
+// Return:
+//   The index of the position
+///////////////////////////////////////////////////////////////////////////////////
+int PositionIndex(unsigned xCells, unsigned oCells)
+{
+	return Base3Cells[xCells] + (2 * Base3Cells[oCells]);
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Solves a position and every position reachable from it into PositionValues.
+//   Every move is expanded, so a table built from the empty board holds an exact
+//   value for every position a game can reach.
+//
+// Arguments:
+//   xCells - The cells X has taken
+//   oCells - The cells O has taken
+//   positionCount - Incremented once for every position solved
+//
+// Return:
+//   The value of the position for the player to move
+///////////////////////////////////////////////////////////////////////////////////
+int SolvePosition(unsigned xCells, unsigned oCells, int *positionCount)
+{
+	int index = PositionIndex(xCells, oCells);
+	if (PositionValues[index] != UnsolvedPosition)
+	{
+		return PositionValues[index];
+	}
+	(*positionCount)++;
+
+	// X moves first, so it is X's move whenever both have taken as many cells
+	bool xToMove = CountBits(xCells) == CountBits(oCells);
+	unsigned freeCells = ~(xCells | oCells) & AllCells;
+	int value;
+
+	if (WinningCells[xToMove ? oCells : xCells])
+	{
+		// The player who just moved has won
+		value = -1;
+	}
+	else if (freeCells == 0)
+	{
+		value = 0;
+	}
+	else
+	{
+		value = -1;
+		while (freeCells != 0)
+		{
+			unsigned move = freeCells & (0u - freeCells);
+			freeCells &= freeCells - 1;
+
+			int childValue = xToMove ? SolvePosition(xCells | move, oCells, positionCount) : SolvePosition(xCells, oCells | move, positionCount);
+			value = std::max(value, -childValue);
+		}
+	}
+
+	PositionValues[index] = (signed char)value;
+	return value;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Fills in Base3Cells and solves every reachable position into PositionValues. 
+//   Must be called before any game is played. Nothing writes to the table after
+//   that, so player threads read it without locks.
+//
+// Return:
+//   Number of reachable positions
+///////////////////////////////////////////////////////////////////////////////////
+int InitPositionValues()
+{
+	int positionCount = 0;
+
+	for (unsigned cells = 0; cells <= AllCells; cells++)
+	{
+		int power = 1;
+		Base3Cells[cells] = 0;
+		for (int cell = 0; cell < 9; cell++, power *= 3)
+		{
+			if ((cells & (1u << cell)) != 0)
+			{
+				Base3Cells[cells] = (unsigned short)(Base3Cells[cells] + power);
+			}
+		}
+	}
+
+	for (int i = 0; i < PositionTableSize; i++)
+	{
+		PositionValues[i] = UnsolvedPosition;
+	}
+	SolvePosition(0, 0, &positionCount);
+
+	return positionCount;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Negamax search with alpha-beta pruning. Values are 1 for a forced win for the
+//   player to move, 0 for a draw and -1 for a forced loss.
+//
+// Arguments:
+//   moverCells - The cells the player to move has taken
+//   otherCells - The cells the other player has taken
+//   alpha - The value the player to move is already sure of
+//   beta - The value the other player is already sure of, as seen by this player
+//   useTable - True to take the value of a position from PositionValues instead
+//     of searching below it
+//
+// Return:
+//   The value of the position, exact if it lies between alpha and beta
+///////////////////////////////////////////////////////////////////////////////////
+int Negamax(unsigned moverCells, unsigned otherCells, int alpha, int beta, bool useTable)
+{
+	if (WinningCells[otherCells])
+	{
+		return -1;
+	}
+
+	unsigned freeCells = ~(moverCells | otherCells) & AllCells;
+	if (freeCells == 0)
+	{
+		return 0;
+	}
+
+	if (useTable)
+	{
+		bool xToMove = CountBits(moverCells) == CountBits(otherCells);
+		return PositionValues[xToMove ? PositionIndex(moverCells, otherCells) : PositionIndex(otherCells, moverCells)];
+	}
+
+	int value = -1;
+	while (freeCells != 0)
+	{
+		unsigned move = freeCells & (0u - freeCells);
+		freeCells &= freeCells - 1;
+
+		value = std::max(value, -Negamax(otherCells, moverCells | move, -beta, -alpha, false));
+		alpha = std::max(alpha, value);
+		if (alpha >= beta)
+		{
+			break;
+		}
+	}
+	return value;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Picks a move that keeps the best value the player can get. Each move is 
+//   searched with the full window, so ties are known and broken at random.
+//
+// Arguments:
+//   moverCells - The cells the player to move has taken
+//   otherCells - The cells the other player has taken
+//   useTable - True to read the value after each move from PositionValues, false
+//     to search for it
+//   rand - The random number generator used to break ties
+//
+// Return:
+//   The bit of the cell picked
+///////////////////////////////////////////////////////////////////////////////////
+unsigned PickBestCell(unsigned moverCells, unsigned otherCells, bool useTable, FastRand *rand)
+{
+	unsigned freeCells = ~(moverCells | otherCells) & AllCells;
+	unsigned bestCells = 0;
+	int bestValue = -2;
+
+	while (freeCells != 0)
+	{
+		unsigned move = freeCells & (0u - freeCells);
+		freeCells &= freeCells - 1;
+
+		int value = -Negamax(otherCells, moverCells | move, -1, 1, useTable);
+		if (value > bestValue)
+		{
+			bestValue = value;
+			bestCells = move;
+		}
+		else if (value == bestValue)
+		{
+			bestCells |= move;
+		}
+	}
+
+	return PickRandomCell(bestCells, rand);
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Picks the next move for a player with its strategy.
+//
+// Arguments:
+//   currentPlayer - The player to move
+//   currentGame - The game
+//
+// Return:
+//   The bit of the cell picked
+///////////////////////////////////////////////////////////////////////////////////
+unsigned PickCell(Player *currentPlayer, const Game *currentGame)
+{
+	unsigned moverCells = (currentPlayer->type == PlayerType::X) ? currentGame->xCells : currentGame->oCells;
+	unsigned otherCells = (currentPlayer->type == PlayerType::X) ? currentGame->oCells : currentGame->xCells;
+
+	switch (currentPlayer->strategy)
+	{
+	case PlayerStrategy::Perfect:
+		return PickBestCell(moverCells, otherCells, true, &currentPlayer->myRand);
+	case PlayerStrategy::Search:
+		return PickBestCell(moverCells, otherCells, false, &currentPlayer->myRand);
+	default:
+		return PickRandomCell(FreeCells(currentGame), &currentPlayer->myRand);
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////////
 // Prints the current game board to the console
 //
@@ -268,13 +737,15 @@ void PrintGameBoard(const Game *currentGame)
 	{
 		for(int col = 0; col < 3; col++)
 		{
-			if (currentGame->gameBoard[row][col] == PlayerType::None)
+			unsigned cell = 1u << ((row * 3) + col);
+
+			if (((currentGame->xCells | currentGame->oCells) & cell) == 0)
 			{
 				printf("[ ]");
 			}
 			else
 			{
-				printf("[%c]", (currentGame->gameBoard[row][col] == PlayerType::X) ? 'X' : 'O');
+				printf("[%c]", ((currentGame->xCells & cell) != 0) ? 'X' : 'O');
 			}
 			std::this_thread::yield();
 		}
@@ -288,36 +759,32 @@ void PrintGameBoard(const Game *currentGame)
 // Determines if the player made a winning move on the game board
 //
 // Arguments:
-//   row - The row 'player' picked to play at
-//   col - The column 'player' picked to play at
 //   game - Pointer to the game being checked
 //   player - Pointer to the player that made the move
 //
 // Return:
 //   True if player won, otherwise false
 ///////////////////////////////////////////////////////////////////////////////////
-bool DidWeWin(int row, int col, const Game *game, const Player *player)
+bool DidWeWin(const Game *game, const Player *player)
 {
-	bool completeRow = true;
-	bool completeCol = true;
-	bool completeDiagonalA = true;
-	bool completeDiagonalB = true;
+	// Only the player's own cells matter, one lookup covers all eight lines
+	return WinningCells[(player->type == PlayerType::X) ? game->xCells : game->oCells];
+}
 
-	// Check specified row, column, and both diagonals to see if this player made
-	//  a winning move.
-	for (int i = 0; i < 3; i++)
+///////////////////////////////////////////////////////////////////////////////////
+// Records how long after the starting gun the first move of any game was made.
+//
+// Arguments:
+//   gamePool - The pool of games
+///////////////////////////////////////////////////////////////////////////////////
+void RecordFirstMove(GamePool *gamePool)
+{
+	if (gamePool->firstMoveTime.load(std::memory_order_relaxed) == -1)
 	{
-		if(game->gameBoard[row][i] != player->type)
-			completeRow = false;
-		if(game->gameBoard[i][col] != player->type)
-			completeCol = false;
-		if(game->gameBoard[i][i] != player->type)
-			completeDiagonalA = false;
-		if(game->gameBoard[2 - i][i] != player->type)
-			completeDiagonalB = false;
+		long long expected = -1;
+		long long sinceGun = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - gamePool->gunFired).count();
+		gamePool->firstMoveTime.compare_exchange_strong(expected, sinceGun);
 	}
-
-	return completeRow || completeCol || completeDiagonalA || completeDiagonalB;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////
@@ -331,33 +798,23 @@ bool DidWeWin(int row, int col, const Game *game, const Player *player)
 ///////////////////////////////////////////////////////////////////////////////////
 GameState MakeAMove(Player *currentPlayer, Game *currentGame)
 {
-	int possibleMoves[9];
-	int totalPossibleMoves = 0;
-
-	// Find all valid moves this player can make
-	for (int row = 0; row < 3; row++)
-	{
-		for(int col = 0; col < 3; col++)
-		{
-			if (currentGame->gameBoard[row][col] == PlayerType::None)
-			{
-				possibleMoves[totalPossibleMoves++] = (row * 3) + col;
-			}
-		}
-	}
+	// Every valid move this player can make
+	unsigned freeCells = FreeCells(currentGame);
 
-	if (totalPossibleMoves != 0) 
+	if (freeCells != 0) 
 	{ 
-		// There are valid moves left on the board, pick a random valid location
-		int randomMoveIndex = currentPlayer->myRand() % totalPossibleMoves;
+		// There are valid moves left on the board, pick one with the player's strategy
+		unsigned move = PickCell(currentPlayer, currentGame);
+		unsigned short *playerCells = (currentPlayer->type == PlayerType::X) ? &currentGame->xCells : &currentGame->oCells;
 
-		int row = possibleMoves[randomMoveIndex] / 3;
-		int col = possibleMoves[randomMoveIndex] % 3;
-		currentGame->gameBoard[row][col] = currentPlayer->type;
+		int row = CountTrailingZeros(move) / 3;
+		int col = CountTrailingZeros(move) % 3;
+		*playerCells |= (unsigned short)move;
+		RecordFirstMove(currentPlayer->gamePool);
 
 		Log("Game %d: Player %d: Picked [Row: %d, Col: %d]\n", currentGame->gameNumber, currentPlayer->id, row, col);
 
-		if (DidWeWin(row, col, currentGame, currentPlayer)) 
+		if (DidWeWin(currentGame, currentPlayer)) 
 		{ 
 			Log("Game %d:Player %d - Won\n", currentGame->gameNumber, currentPlayer->id);
 			currentPlayer->winCount++;
@@ -507,64 +964,243 @@ void JoinGame(Player *currentPlayer, Game *currentGame)
 }
 
 ///////////////////////////////////////////////////////////////////////////////////
-// Makes the specified player try to sequentially join and play each game in the
-//   pool of games.
+// Pushes a player onto the matchmaking queue. Any thread may enqueue.
 //
 // Arguments:
-//   currentPlayer - Pointer to the player that is trying to play each game
+//   playerPool - The pool of players
+//   playerId - ID of the player to queue
+//
+// Return:
+//   True if the player was queued, false if the queue was full
 ///////////////////////////////////////////////////////////////////////////////////
-void TryToPlayEachGame(Player *currentPlayer)
+bool EnqueuePlayer(PlayerPool *playerPool, int playerId)
 {
-	Log("Player %d starting to play games...\n", currentPlayer->id);
-
-	Game *listOfGames = currentPlayer->gamePool->perGameData;
-	int totalGameCount = currentPlayer->gamePool->totalGameCount;
+	unsigned position = playerPool->enqueuePosition.load(std::memory_order_relaxed);
+	MatchSlot *slot;
 
-	// All of our player threads will be going through the pool of games looking for the any
-	//   games that aren't full. The player will join and play any non-full games it finds while
-	//   iterating through the list of games.
-	for (int i = 0; i < totalGameCount; i++) 
+	while (true)
 	{
-		// Check to see if we can join this game
-		listOfGames[i].playerCountMutex.lock();
-		if (listOfGames[i].playerCount == 2)
+		slot = &playerPool->slots[position & playerPool->slotMask];
+		int difference = (int)(slot->sequence.load(std::memory_order_acquire) - position);
+
+		if (difference == 0)
 		{
-			// Game is full, skip it
-			listOfGames[i].playerCountMutex.unlock();
-			continue;
+			// The slot is free for this position, claim the position
+			if (playerPool->enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (difference < 0)
+		{
+			// The slot still holds a player from one lap ago
+			return false;
+		}
+		else
+		{
+			// Another producer took this position first
+			position = playerPool->enqueuePosition.load(std::memory_order_relaxed);
 		}
-
-		// This game wasn't full so we will join it
-		listOfGames[i].playerCount++;
-		listOfGames[i].playerCountMutex.unlock();
-
-		// We joined the game so we can start playing it
-		JoinGame(currentPlayer, &listOfGames[i]);
 	}
+
+	slot->playerId = playerId;
+	slot->sequence.store(position + 1, std::memory_order_release);
+	return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////
-// Entry point for player threads. 
+// Pops the player that has been queued longest. Any thread may dequeue.
 //
 // Arguments:
-//   currentPlayer - Pointer to a player struct that is unique to this thread
+//   playerPool - The pool of players
+//   playerId - Set to the ID of the player popped
+//
+// Return:
+//   True if a player was popped, false if the queue was empty
 ///////////////////////////////////////////////////////////////////////////////////
-void PlayerThreadEntrypoint(Player *currentPlayer)
+bool DequeuePlayer(PlayerPool *playerPool, int *playerId)
 {
-	Log("Player %d waiting on starting gun\n", currentPlayer->id);
-
-	///////////////////////////////////////////////////////////////////////////////////
-	//   Let main know there's one more player thread running then wait for a
-	//   notification from main via the condition variable you created in the PlayerPool
-	//   struct.
-	///////////////////////////////////////////////////////////////////////////////////
+	unsigned position = playerPool->dequeuePosition.load(std::memory_order_relaxed);
+	MatchSlot *slot;
 
-	currentPlayer->count->lock();
+	while (true)
+	{
+		slot = &playerPool->slots[position & playerPool->slotMask];
+		int difference = (int)(slot->sequence.load(std::memory_order_acquire) - (position + 1));
 
-	(*currentPlayer->ready)++;
-	currentPlayer->mainCV->notify_one();
-	
-	std::unique_lock<std::mutex> locked(*currentPlayer->gun);
+		if (difference == 0)
+		{
+			// The slot has been written for this position, claim the position
+			if (playerPool->dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (difference < 0)
+		{
+			// Nothing has been written here yet
+			return false;
+		}
+		else
+		{
+			// Another consumer took this position first
+			position = playerPool->dequeuePosition.load(std::memory_order_relaxed);
+		}
+	}
+
+	*playerId = slot->playerId;
+	slot->sequence.store(position + playerPool->slotMask + 1, std::memory_order_release);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Tells a waiting player which game to play next.
+//
+// Arguments:
+//   currentPlayer - The player
+//   gameIndex - Index of the game, or NoGamesLeft
+///////////////////////////////////////////////////////////////////////////////////
+void AssignGame(Player *currentPlayer, int gameIndex)
+{
+	std::lock_guard<std::mutex> matchLock(currentPlayer->matchMutex);
+	currentPlayer->assignedGame = gameIndex;
+	currentPlayer->matchCondition.notify_one();
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Queues the player for matchmaking and waits for the matcher to assign it a game.
+//
+// Arguments:
+//   currentPlayer - The player
+//
+// Return:
+//   Index of the game to play, or NoGamesLeft
+///////////////////////////////////////////////////////////////////////////////////
+int WaitForGame(Player *currentPlayer)
+{
+	PlayerPool *playerPool = currentPlayer->playerPool;
+
+	currentPlayer->assignedGame = NoGameAssigned;
+	EnqueuePlayer(playerPool, currentPlayer->id);
+
+	// Only wake the matcher if it is asleep. The fence pairs with the matcher's, so 
+	//   either we see it waiting or it sees us in the queue before it sleeps.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (playerPool->matcherWaiting.load(std::memory_order_relaxed))
+	{
+		std::lock_guard<std::mutex> matcherLock(playerPool->matcherMutex);
+		playerPool->matcherCondition.notify_one();
+	}
+
+	std::unique_lock<std::mutex> matchLock(currentPlayer->matchMutex);
+	currentPlayer->matchCondition.wait(matchLock, [currentPlayer](){return currentPlayer->assignedGame != NoGameAssigned; });
+	return currentPlayer->assignedGame;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Entry point for the matcher thread. Pairs up queued players and gives each pair
+//   the next game, in order. Once every game has been handed out, each player is 
+//   told there are none left as it queues up, and the matcher stops after the last.
+//
+// Arguments:
+//   playerPool - The pool of players
+///////////////////////////////////////////////////////////////////////////////////
+void MatcherThreadEntrypoint(PlayerPool *playerPool)
+{
+	int playersReleased = 0;
+	int unmatchedPlayer = -1;
+
+	while (playersReleased < playerPool->totalPlayerCount)
+	{
+		int playerId;
+
+		if (DequeuePlayer(playerPool, &playerId) == false)
+		{
+			// Nobody is queued, sleep until a player queues up
+			std::unique_lock<std::mutex> matcherLock(playerPool->matcherMutex);
+			playerPool->matcherWaiting.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			if (DequeuePlayer(playerPool, &playerId) == false)
+			{
+				playerPool->matcherCondition.wait(matcherLock);
+				playerPool->matcherWaiting.store(false, std::memory_order_relaxed);
+				continue;
+			}
+			playerPool->matcherWaiting.store(false, std::memory_order_relaxed);
+		}
+
+		if (playerPool->nextGame == playerPool->gamePool->totalGameCount)
+		{
+			AssignGame(&playerPool->perPlayerData[playerId], NoGamesLeft);
+			playersReleased++;
+		}
+		else if (unmatchedPlayer == -1)
+		{
+			// Hold on to the first of a pair. Nobody is held once the games run out, 
+			//   since handing out the last game takes the held player with it.
+			unmatchedPlayer = playerId;
+		}
+		else
+		{
+			int gameIndex = playerPool->nextGame++;
+			AssignGame(&playerPool->perPlayerData[unmatchedPlayer], gameIndex);
+			AssignGame(&playerPool->perPlayerData[playerId], gameIndex);
+			unmatchedPlayer = -1;
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Makes the specified player play every game the matcher assigns it, until there
+//   are no games left.
+//
+// Arguments:
+//   currentPlayer - Pointer to the player that is trying to play each game
+///////////////////////////////////////////////////////////////////////////////////
+void TryToPlayEachGame(Player *currentPlayer)
+{
+	Log("Player %d starting to play games...\n", currentPlayer->id);
+
+	Game *listOfGames = currentPlayer->gamePool->perGameData;
+
+	// The player never looks for a game itself. It queues up, gets paired with
+	//   another player and a game nobody has played, plays it and queues up again.
+	while (true) 
+	{
+		int gameIndex = WaitForGame(currentPlayer);
+		if (gameIndex == NoGamesLeft)
+		{
+			break;
+		}
+
+		// We have been given a game so we can start playing it
+		JoinGame(currentPlayer, &listOfGames[gameIndex]);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Entry point for player threads. 
+//
+// Arguments:
+//   currentPlayer - Pointer to a player struct that is unique to this thread
+///////////////////////////////////////////////////////////////////////////////////
+void PlayerThreadEntrypoint(Player *currentPlayer)
+{
+	Log("Player %d waiting on starting gun\n", currentPlayer->id);
+
+	///////////////////////////////////////////////////////////////////////////////////
+	//   Let main know there's one more player thread running then wait for a
+	//   notification from main via the condition variable you created in the PlayerPool
+	//   struct.
+	///////////////////////////////////////////////////////////////////////////////////
+
+	currentPlayer->count->lock();
+
+	(*currentPlayer->ready)++;
+	currentPlayer->mainCV->notify_one();
+	
+	std::unique_lock<std::mutex> locked(*currentPlayer->gun);
 	currentPlayer->count->unlock();
 	currentPlayer->gunCV->wait(locked, [currentPlayer](){return *currentPlayer->isGunOpen == true; });
 
@@ -587,6 +1223,442 @@ void PlayerThreadEntrypoint(Player *currentPlayer)
 	currentPlayer->count->unlock();
 }
 
+///////////////////////////////////////////////////////////////////////////////////
+// Scalar game kernels, also the fallback where there is no SIMD. The random cell
+//   is picked as (16 random bits * free cells) >> 16, like the SIMD kernels, so
+//   all of them make the same moves.
+///////////////////////////////////////////////////////////////////////////////////
+void ApplyRandomMovesScalar(GameStore *store, int first, int count, FastRand *rand)
+{
+	for (int group = first; group < first + count; group += 4)
+	{
+		unsigned long long randomBits = (*rand)();
+
+		for (int i = group; i < group + 4; i++, randomBits >>= 16)
+		{
+			if (store->state[i] != (unsigned short)GameState::StillPlaying)
+			{
+				continue;
+			}
+
+			unsigned freeCells = ~(store->xCells[i] | store->oCells[i]) & AllCells;
+			int pick = (int)(((randomBits & 0xFFFF) * CountBits(freeCells)) >> 16);
+			unsigned short move = (unsigned short)SelectBit(freeCells, pick);
+
+			if (store->turn[i] == 0)
+			{
+				store->xCells[i] |= move;
+			}
+			else
+			{
+				store->oCells[i] |= move;
+			}
+			store->turn[i] ^= 1;
+		}
+	}
+}
+
+void EvaluateGamesScalar(GameStore *store, int first, int count)
+{
+	for (int i = first; i < first + count; i++)
+	{
+		if (store->state[i] != (unsigned short)GameState::StillPlaying)
+		{
+			continue;
+		}
+
+		// The turn has already passed, so turn 1 means X just moved
+		unsigned moverCells = (store->turn[i] == 1) ? store->xCells[i] : store->oCells[i];
+
+		if (WinningCells[moverCells])
+		{
+			store->state[i] = (unsigned short)GameState::Won;
+		}
+		else if ((store->xCells[i] | store->oCells[i]) == AllCells)
+		{
+			store->state[i] = (unsigned short)GameState::Draw;
+		}
+	}
+}
+
+#if defined HAS_SSE2_KERNELS
+///////////////////////////////////////////////////////////////////////////////////
+// SSE2 game kernels, 8 games per instruction in 16-bit lanes.
+///////////////////////////////////////////////////////////////////////////////////
+void ApplyRandomMovesSse2(GameStore *store, int first, int count, FastRand *rand)
+{
+	const __m128i allCells = _mm_set1_epi16((short)AllCells);
+	const __m128i one = _mm_set1_epi16(1);
+	const __m128i zero = _mm_setzero_si128();
+
+	for (int i = first; i < first + count; i += 8)
+	{
+		__m128i xCells = _mm_loadu_si128((const __m128i *)&store->xCells[i]);
+		__m128i oCells = _mm_loadu_si128((const __m128i *)&store->oCells[i]);
+		__m128i turn = _mm_loadu_si128((const __m128i *)&store->turn[i]);
+		__m128i playing = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *)&store->state[i]), zero);
+		__m128i freeCells = _mm_andnot_si128(_mm_or_si128(xCells, oCells), allCells);
+
+		// Count the free cells in each lane
+		__m128i freeCount = _mm_sub_epi16(freeCells, _mm_and_si128(_mm_srli_epi16(freeCells, 1), _mm_set1_epi16(0x5555)));
+		freeCount = _mm_add_epi16(_mm_and_si128(freeCount, _mm_set1_epi16(0x3333)), _mm_and_si128(_mm_srli_epi16(freeCount, 2), _mm_set1_epi16(0x3333)));
+		freeCount = _mm_and_si128(_mm_add_epi16(freeCount, _mm_srli_epi16(freeCount, 4)), _mm_set1_epi16(0x0F0F));
+		freeCount = _mm_and_si128(_mm_add_epi16(freeCount, _mm_srli_epi16(freeCount, 8)), _mm_set1_epi16(0x1F));
+
+		long long randomLow = (long long)(*rand)();
+		long long randomHigh = (long long)(*rand)();
+		__m128i pick = _mm_mulhi_epu16(_mm_set_epi64x(randomHigh, randomLow), freeCount);
+
+		// Walk the cells, counting pick down on each free one. The free cell found 
+		//   when it reaches zero is the move.
+		__m128i move = zero;
+		for (int cell = 0; cell < 9; cell++)
+		{
+			__m128i bit = _mm_set1_epi16((short)(1 << cell));
+			__m128i isFree = _mm_cmpeq_epi16(_mm_and_si128(freeCells, bit), bit);
+			__m128i chosen = _mm_and_si128(isFree, _mm_cmpeq_epi16(pick, zero));
+			move = _mm_or_si128(move, _mm_and_si128(chosen, bit));
+			pick = _mm_add_epi16(pick, isFree);
+		}
+		move = _mm_and_si128(move, playing);
+
+		__m128i xTurn = _mm_cmpeq_epi16(turn, zero);
+		xCells = _mm_or_si128(xCells, _mm_and_si128(xTurn, move));
+		oCells = _mm_or_si128(oCells, _mm_andnot_si128(xTurn, move));
+		turn = _mm_xor_si128(turn, _mm_and_si128(playing, one));
+
+		_mm_storeu_si128((__m128i *)&store->xCells[i], xCells);
+		_mm_storeu_si128((__m128i *)&store->oCells[i], oCells);
+		_mm_storeu_si128((__m128i *)&store->turn[i], turn);
+	}
+}
+
+void EvaluateGamesSse2(GameStore *store, int first, int count)
+{
+	const __m128i allCells = _mm_set1_epi16((short)AllCells);
+	const __m128i one = _mm_set1_epi16(1);
+	const __m128i zero = _mm_setzero_si128();
+
+	for (int i = first; i < first + count; i += 8)
+	{
+		__m128i xCells = _mm_loadu_si128((const __m128i *)&store->xCells[i]);
+		__m128i oCells = _mm_loadu_si128((const __m128i *)&store->oCells[i]);
+		__m128i state = _mm_loadu_si128((const __m128i *)&store->state[i]);
+		__m128i playing = _mm_cmpeq_epi16(state, zero);
+		__m128i xMoved = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *)&store->turn[i]), one);
+		__m128i moverCells = _mm_or_si128(_mm_and_si128(xMoved, xCells), _mm_andnot_si128(xMoved, oCells));
+
+		__m128i won = zero;
+		for (int line = 0; line < 8; line++)
+		{
+			__m128i lineCells = _mm_set1_epi16((short)WinLines[line]);
+			won = _mm_or_si128(won, _mm_cmpeq_epi16(_mm_and_si128(moverCells, lineCells), lineCells));
+		}
+		__m128i full = _mm_cmpeq_epi16(_mm_or_si128(xCells, oCells), allCells);
+
+		// A game still being played has state 0, so the new state can be or'ed in
+		__m128i newState = _mm_or_si128(_mm_and_si128(won, _mm_set1_epi16((short)GameState::Won)),
+			_mm_andnot_si128(won, _mm_and_si128(full, _mm_set1_epi16((short)GameState::Draw))));
+		state = _mm_or_si128(state, _mm_and_si128(playing, newState));
+
+		_mm_storeu_si128((__m128i *)&store->state[i], state);
+	}
+}
+#endif
+
+#if defined HAS_AVX2_KERNELS
+///////////////////////////////////////////////////////////////////////////////////
+// AVX2 game kernels, 16 games per instruction in 16-bit lanes. The same steps as
+//   the SSE2 kernels.
+///////////////////////////////////////////////////////////////////////////////////
+void ApplyRandomMovesAvx2(GameStore *store, int first, int count, FastRand *rand)
+{
+	const __m256i allCells = _mm256_set1_epi16((short)AllCells);
+	const __m256i one = _mm256_set1_epi16(1);
+	const __m256i zero = _mm256_setzero_si256();
+
+	for (int i = first; i < first + count; i += 16)
+	{
+		__m256i xCells = _mm256_loadu_si256((const __m256i *)&store->xCells[i]);
+		__m256i oCells = _mm256_loadu_si256((const __m256i *)&store->oCells[i]);
+		__m256i turn = _mm256_loadu_si256((const __m256i *)&store->turn[i]);
+		__m256i playing = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *)&store->state[i]), zero);
+		__m256i freeCells = _mm256_andnot_si256(_mm256_or_si256(xCells, oCells), allCells);
+
+		__m256i freeCount = _mm256_sub_epi16(freeCells, _mm256_and_si256(_mm256_srli_epi16(freeCells, 1), _mm256_set1_epi16(0x5555)));
+		freeCount = _mm256_add_epi16(_mm256_and_si256(freeCount, _mm256_set1_epi16(0x3333)), _mm256_and_si256(_mm256_srli_epi16(freeCount, 2), _mm256_set1_epi16(0x3333)));
+		freeCount = _mm256_and_si256(_mm256_add_epi16(freeCount, _mm256_srli_epi16(freeCount, 4)), _mm256_set1_epi16(0x0F0F));
+		freeCount = _mm256_and_si256(_mm256_add_epi16(freeCount, _mm256_srli_epi16(freeCount, 8)), _mm256_set1_epi16(0x1F));
+
+		long long random0 = (long long)(*rand)();
+		long long random1 = (long long)(*rand)();
+		long long random2 = (long long)(*rand)();
+		long long random3 = (long long)(*rand)();
+		__m256i pick = _mm256_mulhi_epu16(_mm256_set_epi64x(random3, random2, random1, random0), freeCount);
+
+		__m256i move = zero;
+		for (int cell = 0; cell < 9; cell++)
+		{
+			__m256i bit = _mm256_set1_epi16((short)(1 << cell));
+			__m256i isFree = _mm256_cmpeq_epi16(_mm256_and_si256(freeCells, bit), bit);
+			__m256i chosen = _mm256_and_si256(isFree, _mm256_cmpeq_epi16(pick, zero));
+			move = _mm256_or_si256(move, _mm256_and_si256(chosen, bit));
+			pick = _mm256_add_epi16(pick, isFree);
+		}
+		move = _mm256_and_si256(move, playing);
+
+		__m256i xTurn = _mm256_cmpeq_epi16(turn, zero);
+		xCells = _mm256_or_si256(xCells, _mm256_and_si256(xTurn, move));
+		oCells = _mm256_or_si256(oCells, _mm256_andnot_si256(xTurn, move));
+		turn = _mm256_xor_si256(turn, _mm256_and_si256(playing, one));
+
+		_mm256_storeu_si256((__m256i *)&store->xCells[i], xCells);
+		_mm256_storeu_si256((__m256i *)&store->oCells[i], oCells);
+		_mm256_storeu_si256((__m256i *)&store->turn[i], turn);
+	}
+}
+
+void EvaluateGamesAvx2(GameStore *store, int first, int count)
+{
+	const __m256i allCells = _mm256_set1_epi16((short)AllCells);
+	const __m256i one = _mm256_set1_epi16(1);
+	const __m256i zero = _mm256_setzero_si256();
+
+	for (int i = first; i < first + count; i += 16)
+	{
+		__m256i xCells = _mm256_loadu_si256((const __m256i *)&store->xCells[i]);
+		__m256i oCells = _mm256_loadu_si256((const __m256i *)&store->oCells[i]);
+		__m256i state = _mm256_loadu_si256((const __m256i *)&store->state[i]);
+		__m256i playing = _mm256_cmpeq_epi16(state, zero);
+		__m256i xMoved = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *)&store->turn[i]), one);
+		__m256i moverCells = _mm256_or_si256(_mm256_and_si256(xMoved, xCells), _mm256_andnot_si256(xMoved, oCells));
+
+		__m256i won = zero;
+		for (int line = 0; line < 8; line++)
+		{
+			__m256i lineCells = _mm256_set1_epi16((short)WinLines[line]);
+			won = _mm256_or_si256(won, _mm256_cmpeq_epi16(_mm256_and_si256(moverCells, lineCells), lineCells));
+		}
+		__m256i full = _mm256_cmpeq_epi16(_mm256_or_si256(xCells, oCells), allCells);
+
+		__m256i newState = _mm256_or_si256(_mm256_and_si256(won, _mm256_set1_epi16((short)GameState::Won)),
+			_mm256_andnot_si256(won, _mm256_and_si256(full, _mm256_set1_epi16((short)GameState::Draw))));
+		state = _mm256_or_si256(state, _mm256_and_si256(playing, newState));
+
+		_mm256_storeu_si256((__m256i *)&store->state[i], state);
+	}
+}
+#endif
+
+// Every kernel built for this target, the widest last
+const GameKernel GameKernels[] =
+{
+	{ "scalar", ApplyRandomMovesScalar, EvaluateGamesScalar },
+#if defined HAS_SSE2_KERNELS
+	{ "sse2", ApplyRandomMovesSse2, EvaluateGamesSse2 },
+#endif
+#if defined HAS_AVX2_KERNELS
+	{ "avx2", ApplyRandomMovesAvx2, EvaluateGamesAvx2 },
+#endif
+};
+const int GameKernelCount = sizeof(GameKernels) / sizeof(GameKernels[0]);
+
+///////////////////////////////////////////////////////////////////////////////////
+// Allocates a store for at least gameCount games, all at the start of a game.
+//   Games past gameCount are there to fill the last batch and start as draws, so
+//   the kernels skip them.
+//
+// Arguments:
+//   store - The store to fill in
+//   gameCount - Number of games
+///////////////////////////////////////////////////////////////////////////////////
+void CreateGameStore(GameStore *store, int gameCount)
+{
+	store->count = ((gameCount + BatchSize - 1) / BatchSize) * BatchSize;
+	store->xCells = new unsigned short[store->count];
+	store->oCells = new unsigned short[store->count];
+	store->turn = new unsigned short[store->count];
+	store->state = new unsigned short[store->count];
+
+	for (int i = 0; i < store->count; i++)
+	{
+		store->xCells[i] = 0;
+		store->oCells[i] = 0;
+		store->turn[i] = 0;
+		store->state[i] = (unsigned short)((i < gameCount) ? GameState::StillPlaying : GameState::Draw);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Frees the arrays of a store.
+//
+// Arguments:
+//   store - The store
+///////////////////////////////////////////////////////////////////////////////////
+void DestroyGameStore(GameStore *store)
+{
+	delete [] store->xCells;
+	delete [] store->oCells;
+	delete [] store->turn;
+	delete [] store->state;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Plays a run of games in the store to the end. No game lasts more than nine 
+//   moves, so nine passes finish every one of them.
+//
+// Arguments:
+//   store - The store
+//   first - Index of the first game, a multiple of 16
+//   count - Number of games, a multiple of 16
+//   kernel - The kernels to play them with
+//   rand - The random number generator used for both sides
+///////////////////////////////////////////////////////////////////////////////////
+void PlayStoreBatch(GameStore *store, int first, int count, const GameKernel *kernel, FastRand *rand)
+{
+	for (int pass = 0; pass < 9; pass++)
+	{
+		kernel->applyRandomMoves(store, first, count, rand);
+		kernel->evaluateGames(store, first, count);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Plays a batch of games in lockstep, one move in every unfinished game per pass, 
+//   with no locks and no waiting on the other side. Games that end drop out of 
+//   later passes.
+//
+// Arguments:
+//   batch - The first game of the batch
+//   batchCount - Number of games in the batch
+//   rand - The random number generator used for both sides
+///////////////////////////////////////////////////////////////////////////////////
+void PlayBatch(Game *batch, int batchCount, FastRand *rand)
+{
+	int stillPlaying = batchCount;
+
+	while (stillPlaying > 0)
+	{
+		stillPlaying = 0;
+		for (int i = 0; i < batchCount; i++)
+		{
+			Game *currentGame = &batch[i];
+			if (currentGame->currentGameState != GameState::StillPlaying)
+			{
+				continue;
+			}
+
+			unsigned freeCells = FreeCells(currentGame);
+			unsigned move = PickRandomCell(freeCells, rand);
+			unsigned short *playerCells = (currentGame->currentTurn == PlayerType::X) ? &currentGame->xCells : &currentGame->oCells;
+
+			*playerCells |= (unsigned short)move;
+			currentGame->currentTurn = (currentGame->currentTurn == PlayerType::X) ? PlayerType::O : PlayerType::X;
+
+			if (WinningCells[*playerCells])
+			{
+				currentGame->currentGameState = GameState::Won;
+			}
+			else if (freeCells == move)
+			{
+				currentGame->currentGameState = GameState::Draw;
+			}
+			else
+			{
+				stillPlaying++;
+			}
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Entry point for batch and simd mode worker threads. Claims batches of games until there
+//   are none left. Game i is played by player 2i and player 2i + 1, modulo the 
+//   number of players.
+//
+// Arguments:
+//   currentWorker - Pointer to a worker struct that is unique to this thread
+///////////////////////////////////////////////////////////////////////////////////
+void BatchWorkerEntrypoint(BatchWorker *currentWorker)
+{
+	GamePool *gamePool = currentWorker->gamePool;
+
+	while (true)
+	{
+		int first = gamePool->nextBatch.fetch_add(BatchSize, std::memory_order_relaxed);
+		if (first >= gamePool->totalGameCount)
+		{
+			break;
+		}
+
+		int batchCount = std::min(BatchSize, gamePool->totalGameCount - first);
+		for (int i = first; i < first + batchCount; i++)
+		{
+			gamePool->perGameData[i].playerX = (int)((2LL * i) % currentWorker->totalPlayerCount);
+			gamePool->perGameData[i].playerO = (int)((2LL * i + 1) % currentWorker->totalPlayerCount);
+		}
+
+		RecordFirstMove(gamePool);
+		if (currentWorker->store == nullptr)
+		{
+			PlayBatch(&gamePool->perGameData[first], batchCount, &currentWorker->myRand);
+		}
+		else
+		{
+			// The store always holds whole batches, then the results are copied back
+			//   to the games
+			GameStore *store = currentWorker->store;
+			PlayStoreBatch(store, first, BatchSize, currentWorker->kernel, &currentWorker->myRand);
+
+			for (int i = first; i < first + batchCount; i++)
+			{
+				gamePool->perGameData[i].xCells = store->xCells[i];
+				gamePool->perGameData[i].oCells = store->oCells[i];
+				gamePool->perGameData[i].currentTurn = (store->turn[i] == 0) ? PlayerType::X : PlayerType::O;
+				gamePool->perGameData[i].currentGameState = (GameState)store->state[i];
+			}
+		}
+		currentWorker->gamesPlayed += batchCount;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Credits each player with the games the batch workers played for it. Only called
+//   once every worker has finished.
+//
+// Arguments:
+//   perPlayerData - An array of player structs; one entry for each player.
+//   perGameData - An array of game data; one entry for each game.
+//   totalGameCount - Total number of games
+///////////////////////////////////////////////////////////////////////////////////
+void TallyBatchResults(Player *perPlayerData, const Game *perGameData, int totalGameCount)
+{
+	for (int i = 0; i < totalGameCount; i++)
+	{
+		Player *playerX = &perPlayerData[perGameData[i].playerX];
+		Player *playerO = &perPlayerData[perGameData[i].playerO];
+
+		playerX->gamesPlayed++;
+		playerO->gamesPlayed++;
+
+		if (perGameData[i].currentGameState == GameState::Draw)
+		{
+			playerX->drawCount++;
+			playerO->drawCount++;
+		}
+		else if (WinningCells[perGameData[i].xCells])
+		{
+			playerX->winCount++;
+			playerO->loseCount++;
+		}
+		else
+		{
+			playerO->winCount++;
+			playerX->loseCount++;
+		}
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////////
 // Displays the results of all players and all games to the console.
 //
@@ -607,8 +1679,9 @@ void PrintResults(const Player *perPlayerData, int totalPlayerCount, const Game
 	printf("********* Player Results **********\n");
 	for (int i = 0; i < totalPlayerCount; i++) 
 	{
-		printf("Player %d, Played %d game(s), Won %d, Lost %d, Draw %d\n",
+		printf("Player %d (%s), Played %d game(s), Won %d, Lost %d, Draw %d\n",
 			perPlayerData[i].id,
+			StrategyNames[(int)perPlayerData[i].strategy],
 			perPlayerData[i].gamesPlayed,
 			perPlayerData[i].winCount,
 			perPlayerData[i].loseCount,
@@ -644,6 +1717,302 @@ void PrintResults(const Player *perPlayerData, int totalPlayerCount, const Game
 	printf("Total Games = %d, %d Games Won, %d Games were a Draw\n\n\n", totalGameCount, totalGamesWon, totalGamesTied);
 }
 
+///////////////////////////////////////////////////////////////////////////////////
+// Plays random games on one thread with no locks or logging, checking for a win
+//   after every move.
+//
+// Arguments:
+//   gameCount - Number of games to play
+//   useTable - True to check with the WinningCells table, false to compare the
+//     eight lines one by one
+//
+// Return:
+//   Moves made per second
+///////////////////////////////////////////////////////////////////////////////////
+double TimeRandomGames(int gameCount, bool useTable)
+{
+	FastRand rand(12345);
+	long long moves = 0;
+	int wins = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < gameCount; i++)
+	{
+		unsigned cells[2] = { 0, 0 };
+		unsigned freeCells = AllCells;
+		int turn = 0;
+		bool won = false;
+
+		while (!won && freeCells != 0)
+		{
+			unsigned move = PickRandomCell(freeCells, &rand);
+			freeCells &= ~move;
+			cells[turn] |= move;
+			won = useTable ? WinningCells[cells[turn]] : HasWinningLine(cells[turn]);
+			turn ^= 1;
+			moves++;
+		}
+		wins += won ? 1 : 0;
+	}
+	std::chrono::duration<double> runTime = std::chrono::steady_clock::now() - start;
+
+	printf("    %s: %lld moves, %d wins, %.1f million moves/sec\n", useTable ? "table lookup" : "eight lines ",
+		moves, wins, (moves / runTime.count()) / 1000000.0);
+	return moves / runTime.count();
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Plays the same games with every game kernel and checks them against each other,
+//   and every finished board against DidWeWin.
+//
+// Arguments:
+//   gameCount - Number of games to play
+//
+// Return:
+//   Number of games that didn't match
+///////////////////////////////////////////////////////////////////////////////////
+int CheckGameKernels(int gameCount)
+{
+	GameStore stores[GameKernelCount];
+	int mismatches = 0;
+
+	for (int k = 0; k < GameKernelCount; k++)
+	{
+		FastRand rand(12345);
+
+		CreateGameStore(&stores[k], gameCount);
+		for (int first = 0; first < stores[k].count; first += BatchSize)
+		{
+			PlayStoreBatch(&stores[k], first, BatchSize, &GameKernels[k], &rand);
+		}
+	}
+
+	for (int i = 0; i < gameCount; i++)
+	{
+		bool matches = true;
+
+		for (int k = 1; k < GameKernelCount; k++)
+		{
+			matches &= (stores[k].xCells[i] == stores[0].xCells[i]) && (stores[k].oCells[i] == stores[0].oCells[i]) &&
+				(stores[k].turn[i] == stores[0].turn[i]) && (stores[k].state[i] == stores[0].state[i]);
+		}
+
+		// The reference check, on the Game and Player structs the threads play with
+		Game game;
+		Player playerX;
+		Player playerO;
+		game.xCells = stores[0].xCells[i];
+		game.oCells = stores[0].oCells[i];
+		playerX.type = PlayerType::X;
+		playerO.type = PlayerType::O;
+
+		bool xWon = DidWeWin(&game, &playerX);
+		bool oWon = DidWeWin(&game, &playerO);
+		bool xMovedLast = (stores[0].turn[i] == 1);
+		int xMoves = CountBits(game.xCells);
+		int oMoves = CountBits(game.oCells);
+
+		// X moves first, so X has made one more move than O or the same number
+		matches &= (xMoves - oMoves) == (xMovedLast ? 1 : 0);
+		if (stores[0].state[i] == (unsigned short)GameState::Won)
+		{
+			matches &= (xMovedLast ? xWon : oWon) && !(xMovedLast ? oWon : xWon);
+		}
+		else
+		{
+			matches &= (stores[0].state[i] == (unsigned short)GameState::Draw) && !xWon && !oWon && (FreeCells(&game) == 0);
+		}
+
+		mismatches += matches ? 0 : 1;
+	}
+
+	for (int k = 0; k < GameKernelCount; k++)
+	{
+		DestroyGameStore(&stores[k]);
+	}
+	return mismatches;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Plays games in a store on one thread, a batch at a time, like a simd mode 
+//   worker does.
+//
+// Arguments:
+//   gameCount - Number of games to play
+//   kernel - The kernels to play them with
+//
+// Return:
+//   Games played per second
+///////////////////////////////////////////////////////////////////////////////////
+double TimeGameKernel(int gameCount, const GameKernel *kernel)
+{
+	FastRand rand(12345);
+	GameStore store;
+	int wins = 0;
+
+	CreateGameStore(&store, gameCount);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int first = 0; first < store.count; first += BatchSize)
+	{
+		PlayStoreBatch(&store, first, BatchSize, kernel, &rand);
+	}
+	std::chrono::duration<double> runTime = std::chrono::steady_clock::now() - start;
+
+	for (int i = 0; i < gameCount; i++)
+	{
+		wins += (store.state[i] == (unsigned short)GameState::Won) ? 1 : 0;
+	}
+	DestroyGameStore(&store);
+
+	printf("    %-6s: %d wins, %.1f million games/sec\n", kernel->name, wins, (gameCount / runTime.count()) / 1000000.0);
+	return gameCount / runTime.count();
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Plays games between two strategies on one thread, with the X and O players' 
+//   moves picked the way PickCell picks them.
+//
+// Arguments:
+//   gameCount - Number of games to play
+//   xStrategy - How X picks its moves
+//   oStrategy - How O picks its moves
+///////////////////////////////////////////////////////////////////////////////////
+void PlayStrategies(int gameCount, PlayerStrategy xStrategy, PlayerStrategy oStrategy)
+{
+	FastRand rand(12345);
+	int xWins = 0;
+	int oWins = 0;
+
+	for (int i = 0; i < gameCount; i++)
+	{
+		unsigned cells[2] = { 0, 0 };
+		int turn = 0;
+
+		while (true)
+		{
+			PlayerStrategy strategy = (turn == 0) ? xStrategy : oStrategy;
+			unsigned move = (strategy == PlayerStrategy::Random) ? PickRandomCell(~(cells[0] | cells[1]) & AllCells, &rand) :
+				PickBestCell(cells[turn], cells[turn ^ 1], strategy == PlayerStrategy::Perfect, &rand);
+
+			cells[turn] |= move;
+			if (WinningCells[cells[turn]])
+			{
+				xWins += (turn == 0) ? 1 : 0;
+				oWins += (turn == 1) ? 1 : 0;
+				break;
+			}
+			if ((cells[0] | cells[1]) == AllCells)
+			{
+				break;
+			}
+			turn ^= 1;
+		}
+	}
+
+	printf("    X %-7s vs O %-7s: X won %d, O won %d, draws %d\n", StrategyNames[(int)xStrategy], StrategyNames[(int)oStrategy],
+		xWins, oWins, gameCount - xWins - oWins);
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Times how long each strategy takes to pick a move, over the positions of random
+//   games.
+//
+// Arguments:
+//   positionCount - Number of positions to pick a move in
+//   strategy - The strategy to time
+///////////////////////////////////////////////////////////////////////////////////
+void TimeStrategy(int positionCount, PlayerStrategy strategy)
+{
+	FastRand gameRand(12345);
+	FastRand rand(54321);
+	std::vector<unsigned> positions;
+	unsigned checksum = 0;
+
+	// Positions from random games, as mover cells in the low half and the other
+	//   player's cells in the high half
+	while ((int)positions.size() < positionCount)
+	{
+		unsigned cells[2] = { 0, 0 };
+		int turn = 0;
+
+		while (!WinningCells[cells[turn ^ 1]] && (cells[0] | cells[1]) != AllCells && (int)positions.size() < positionCount)
+		{
+			positions.push_back(cells[turn] | (cells[turn ^ 1] << 16));
+			cells[turn] |= PickRandomCell(~(cells[0] | cells[1]) & AllCells, &gameRand);
+			turn ^= 1;
+		}
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < positionCount; i++)
+	{
+		unsigned moverCells = positions[i] & 0xFFFF;
+		unsigned otherCells = positions[i] >> 16;
+
+		checksum += (strategy == PlayerStrategy::Random) ? PickRandomCell(~(moverCells | otherCells) & AllCells, &rand) :
+			PickBestCell(moverCells, otherCells, strategy == PlayerStrategy::Perfect, &rand);
+	}
+	std::chrono::duration<double> runTime = std::chrono::steady_clock::now() - start;
+
+	printf("    %-7s: %.1f ns per move (checksum %u)\n", StrategyNames[(int)strategy], (runTime.count() * 1000000000.0) / positionCount, checksum);
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Times building the table of solved positions and picking a move with each
+//   strategy, then plays the strategies against each other.
+///////////////////////////////////////////////////////////////////////////////////
+void BenchmarkStrategies()
+{
+	const int buildCount = 1000;
+	int positionCount = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < buildCount; i++)
+	{
+		positionCount = InitPositionValues();
+	}
+	std::chrono::duration<double> runTime = std::chrono::steady_clock::now() - start;
+
+	printf("Solved positions\n");
+	printf("    %d reachable positions of %d, built in %.1f us\n\n", positionCount, PositionTableSize, (runTime.count() * 1000000.0) / buildCount);
+
+	printf("Move decisions\n");
+	TimeStrategy(1000000, PlayerStrategy::Random);
+	TimeStrategy(1000000, PlayerStrategy::Perfect);
+	TimeStrategy(100000, PlayerStrategy::Search);
+	printf("\n");
+
+	printf("Strategies, 100000 games each\n");
+	PlayStrategies(100000, PlayerStrategy::Perfect, PlayerStrategy::Random);
+	PlayStrategies(100000, PlayerStrategy::Random, PlayerStrategy::Perfect);
+	PlayStrategies(100000, PlayerStrategy::Perfect, PlayerStrategy::Perfect);
+	PlayStrategies(100000, PlayerStrategy::Search, PlayerStrategy::Perfect);
+	printf("\n");
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Times the bitboard move and win checks on their own, outside of the threads
+//   and locks of a full run, then checks and times the game kernels.
+///////////////////////////////////////////////////////////////////////////////////
+void BenchmarkMoves()
+{
+	const int gameCount = 10000000;
+
+	printf("Random moves, %d games\n", gameCount);
+	TimeRandomGames(gameCount, false);
+	TimeRandomGames(gameCount, true);
+	printf("\n");
+
+	printf("Game kernels, %d games\n", gameCount);
+	printf("    %d game(s) differ between the kernels or from DidWeWin\n", CheckGameKernels(gameCount));
+	for (int k = 0; k < GameKernelCount; k++)
+	{
+		TimeGameKernel(gameCount, &GameKernels[k]);
+	}
+	printf("\n");
+}
+
 int main(int argc, char **argv)
 {
 	ENABLE_LEAK_DETECTION();
@@ -661,19 +2030,102 @@ int main(int argc, char **argv)
 	Game *perGameData;
 	// Contains all of the games. See GamePool for more details.
 	GamePool poolOfGames; 
+	// True to play the games on a pool of batch workers instead of player threads.
+	bool batchMode = false;
+	// True if the batch workers play a GameStore with the widest game kernels.
+	bool simdMode = false;
+	// Number of batch workers, one per hardware thread unless given.
+	int workerCount = (int)std::thread::hardware_concurrency();
+	// Strategies of the even and odd numbered players in threads mode.
+	PlayerStrategy evenStrategy = PlayerStrategy::Random;
+	PlayerStrategy oddStrategy = PlayerStrategy::Random;
+
+	InitWinningCells();
+	InitPositionValues();
+
+	if ((argc == 2) && (strcmp(argv[1], "bench") == 0))
+	{
+		BenchmarkMoves();
+		BenchmarkStrategies();
+		Pause();
+		return 0;
+	}
 
-	if (argc != 3)
+	if (argc < 3 || argc > 5)
 	{
-		fprintf(stderr, "Usage: TicTacToe gameCount playerCount\n\n");
+		fprintf(stderr, "Usage: TicTacToe gameCount playerCount [threads [strategy]]\n");
+		fprintf(stderr, "       TicTacToe gameCount playerCount batch|simd [workerCount]\n");
+		fprintf(stderr, "       TicTacToe bench\n\n");
 		fprintf(stderr, "Arguments:\n");
 		fprintf(stderr, "    gameCount                    Number of games.                              \n");
 		fprintf(stderr, "    playerCount                  Number of players.                            \n");
+		fprintf(stderr, "    mode                         threads: a thread per player (default).       \n");
+		fprintf(stderr, "                                 batch: a pool of workers plays both sides.    \n");
+		fprintf(stderr, "                                 simd: batch, with SIMD kernels on a SoA store.\n");
+		fprintf(stderr, "    strategy                     random: any free cell (default).              \n");
+		fprintf(stderr, "                                 perfect: best move from the solved positions. \n");
+		fprintf(stderr, "                                 search: best move from an alpha-beta search.  \n");
+		fprintf(stderr, "                                 mixed: even players perfect, odd random.      \n");
+		fprintf(stderr, "    workerCount                  Number of batch workers (default: one per     \n");
+		fprintf(stderr, "                                 hardware thread).                             \n");
 		Pause();
 		return 1;
 	}
 	totalGameCount = atoi(argv[1]);
 	totalPlayerCount = atoi(argv[2]);
 
+	if (argc > 3)
+	{
+		if (strcmp(argv[3], "batch") == 0)
+		{
+			batchMode = true;
+		}
+		else if (strcmp(argv[3], "simd") == 0)
+		{
+			batchMode = true;
+			simdMode = true;
+		}
+		else if (strcmp(argv[3], "threads") != 0)
+		{
+			fprintf(stderr, "Error: mode must be threads, batch or simd.\n");
+			Pause();
+			return 1;
+		}
+	}
+
+	if ((argc > 4) && !batchMode)
+	{
+		if (strcmp(argv[4], "perfect") == 0)
+		{
+			evenStrategy = oddStrategy = PlayerStrategy::Perfect;
+		}
+		else if (strcmp(argv[4], "search") == 0)
+		{
+			evenStrategy = oddStrategy = PlayerStrategy::Search;
+		}
+		else if (strcmp(argv[4], "mixed") == 0)
+		{
+			evenStrategy = PlayerStrategy::Perfect;
+		}
+		else if (strcmp(argv[4], "random") != 0)
+		{
+			fprintf(stderr, "Error: strategy must be random, perfect, search or mixed.\n");
+			Pause();
+			return 1;
+		}
+	}
+	else if (argc > 4)
+	{
+		workerCount = atoi(argv[4]);
+		if (workerCount < 1)
+		{
+			fprintf(stderr, "Error: Requires at least one worker.\n");
+			Pause();
+			return 1;
+		}
+	}
+	workerCount = std::max(workerCount, 1);
+
 	if(totalGameCount < 0 || totalPlayerCount < 0)
 	{
 		fprintf(stderr, "Error: All arguments must be positive integer values.\n");
@@ -699,6 +2151,30 @@ int main(int argc, char **argv)
 	// Initialize pool of games
 	poolOfGames.perGameData = perGameData;
 	poolOfGames.totalGameCount = totalGameCount;
+	poolOfGames.firstMoveTime = -1;
+	poolOfGames.nextBatch = 0;
+
+	// Initialize the matchmaking queue with a slot for every player
+	unsigned slotCount = 1;
+	while (slotCount < (unsigned)totalPlayerCount)
+	{
+		slotCount *= 2;
+	}
+
+	poolOfPlayers.totalPlayerCount = totalPlayerCount;
+	poolOfPlayers.perPlayerData = perPlayerData;
+	poolOfPlayers.gamePool = &poolOfGames;
+	poolOfPlayers.slots = new MatchSlot[slotCount];
+	poolOfPlayers.slotMask = slotCount - 1;
+	poolOfPlayers.enqueuePosition = 0;
+	poolOfPlayers.dequeuePosition = 0;
+	poolOfPlayers.nextGame = 0;
+	poolOfPlayers.matcherWaiting = false;
+
+	for (unsigned i = 0; i < slotCount; i++)
+	{
+		poolOfPlayers.slots[i].sequence = i;
+	}
 
 	std::condition_variable myMainCV = std::condition_variable(); //count
 	std::condition_variable mygunCV = std::condition_variable();
@@ -715,10 +2191,13 @@ int main(int argc, char **argv)
 		perGameData[i].gameNumber = i + 1;
 		perGameData[i].currentTurn = PlayerType::X;
 		perGameData[i].currentGameState = GameState::StillPlaying;
-		perGameData[i].playerCount = 0;
-		memset(perGameData[i].gameBoard, 0, sizeof(perGameData[i].gameBoard));
+		perGameData[i].xCells = 0;
+		perGameData[i].oCells = 0;
 	}
 
+	// One device read seeds every player's generator
+	FastRand seeds(FastRand::DeviceSeed());
+
 	// Initialize each player
 	for (int i = 0; i < totalPlayerCount; i++) 
 	{
@@ -730,7 +2209,9 @@ int main(int argc, char **argv)
 		perPlayerData[i].gamePool = &poolOfGames;
 		perPlayerData[i].playerPool = &poolOfPlayers;
 		perPlayerData[i].type = PlayerType::None;
-		perPlayerData[i].myRand.Init(0, INT_MAX);
+		perPlayerData[i].strategy = ((i % 2) == 0) ? evenStrategy : oddStrategy;
+		perPlayerData[i].myRand.Seed(seeds());
+		perPlayerData[i].assignedGame = NoGameAssigned;
 		//Mein
 		perPlayerData[i].ready = &readyPlayers;
 		perPlayerData[i].count = &countMutex;
@@ -740,6 +2221,66 @@ int main(int argc, char **argv)
 		perPlayerData[i].mainCV = &myMainCV;
 	}
 
+	if (batchMode)
+	{
+		///////////////////////////////////////////////////////////////////////////////////
+		//   No player threads and no matcher. The workers claim batches of games until
+		//   they run out, then the results are credited to the players.
+		///////////////////////////////////////////////////////////////////////////////////
+		BatchWorker *perWorkerData = new BatchWorker[workerCount];
+		std::vector<std::thread> workers;
+		GameStore store;
+		const GameKernel *kernel = &GameKernels[GameKernelCount - 1];
+
+		if (simdMode)
+		{
+			CreateGameStore(&store, totalGameCount);
+		}
+
+		poolOfGames.gunFired = std::chrono::steady_clock::now();
+		for (int i = 0; i < workerCount; i++)
+		{
+			perWorkerData[i].id = i;
+			perWorkerData[i].gamesPlayed = 0;
+			perWorkerData[i].totalPlayerCount = totalPlayerCount;
+			perWorkerData[i].gamePool = &poolOfGames;
+			perWorkerData[i].store = simdMode ? &store : nullptr;
+			perWorkerData[i].kernel = kernel;
+			perWorkerData[i].myRand.Seed(seeds());
+			workers.push_back(std::thread(BatchWorkerEntrypoint, &perWorkerData[i]));
+		}
+		for (size_t i = 0; i < workers.size(); i++)
+		{
+			WAIT_FOR_THREAD(&workers[i]);
+		}
+		std::chrono::duration<double> runTime = std::chrono::steady_clock::now() - poolOfGames.gunFired;
+
+		TallyBatchResults(perPlayerData, perGameData, totalGameCount);
+		PrintResults(perPlayerData, totalPlayerCount, perGameData, totalGameCount);
+		for (int i = 0; i < workerCount; i++)
+		{
+			printf("Worker %d played %d game(s)\n", perWorkerData[i].id, perWorkerData[i].gamesPlayed);
+		}
+		if (simdMode)
+		{
+			printf("Game kernels: %s\n", kernel->name);
+		}
+		printf("Played %d game(s) in %.3f seconds on %d worker(s), %.0f games/sec\n\n", totalGameCount, runTime.count(), 
+			workerCount, totalGameCount / runTime.count());
+
+		if (simdMode)
+		{
+			DestroyGameStore(&store);
+		}
+		delete [] perWorkerData;
+		delete [] perPlayerData;
+		delete [] perGameData;
+		delete [] poolOfPlayers.slots;
+
+		Pause();
+		return 0;
+	}
+
 	///////////////////////////////////////////////////////////////////////////////////
 	//   Start the player threads. The player threads should begin executing in
 	//   the PlayerThreadEntrypoint function. Make sure to detach the threads.
@@ -748,6 +2289,10 @@ int main(int argc, char **argv)
 	{
 		std::thread(PlayerThreadEntrypoint, &perPlayerData[i]).detach();
 	}
+
+	// The matcher sleeps until the first players queue up
+	std::thread matcher(MatcherThreadEntrypoint, &poolOfPlayers);
+
 	///////////////////////////////////////////////////////////////////////////////////
 	// Wait for all players to be ready 
 	///////////////////////////////////////////////////////////////////////////////////
@@ -759,6 +2304,7 @@ int main(int argc, char **argv)
 	// Notify all waiting threads that they can start playing.
 	///////////////////////////////////////////////////////////////////////////////////
 	gunMutex.lock();
+	poolOfGames.gunFired = std::chrono::steady_clock::now();
 	gunopen = true;
 	mygunCV.notify_all();
 	gunMutex.unlock();
@@ -768,8 +2314,19 @@ int main(int argc, char **argv)
 	///////////////////////////////////////////////////////////////////////////////////
 
 	myMainCV.wait(locked, [&readyPlayers](){return readyPlayers == 0; });
+	std::chrono::duration<double> runTime = std::chrono::steady_clock::now() - poolOfGames.gunFired;
+	WAIT_FOR_THREAD(&matcher);
 
 	PrintResults(perPlayerData, totalPlayerCount, perGameData, totalGameCount);
+	if (poolOfGames.firstMoveTime.load() == -1)
+	{
+		printf("Played %d game(s) in %.3f seconds, no moves\n\n", totalGameCount, runTime.count());
+	}
+	else
+	{
+		printf("Played %d game(s) in %.3f seconds, first move %.3f ms after the starting gun\n\n", totalGameCount, runTime.count(), 
+			poolOfGames.firstMoveTime.load() / 1000.0);
+	}
 
 	///////////////////////////////////////////////////////////////////////////////////
 	// Cleanup
@@ -777,6 +2334,7 @@ int main(int argc, char **argv)
 
 	delete [] perPlayerData;
 	delete [] perGameData;
+	delete [] poolOfPlayers.slots;
 
 	Pause();
 	return 0;
@@ -1,11 +1,25 @@
 #include <iostream>  
 #include <vector>
+#include <string>
+#include <deque>
+#include <queue>
+#include <functional>
 #include <condition_variable>
 #include <thread> 
 #include <chrono>
-#include <random>
+#include <atomic>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
+
+#if defined _WIN32
+	#define NOMINMAX
+	#include <windows.h>
+#elif defined __linux__
+	#include <sched.h>
+#endif
+
+#include "../../Common/FastRand.h"
 
 using namespace std;
 
@@ -21,30 +35,59 @@ using namespace std;
 	#define ENABLE_LEAK_DETECTION()
 #endif
 
+// Records every resource mutex wait, lock and unlock for the lock graph checker.
+//   Define as 0 to compile the checker out completely.
+#ifndef ENABLE_LOCK_GRAPH
+	#define ENABLE_LOCK_GRAPH 1
+#endif
 
-class UniformRandInt
-{
-public:
-	void Init(int min, int max)
-	{
-		// Seed our random number generator with a non-deterministic random value. If no such capabilities exist then
-		//   the number will be pulled from a pseudo random number generator.
-		randEngine.seed(randDevice());
+#if ENABLE_LOCK_GRAPH
+	#define RECORD_LOCK_EVENT(drinker, type, shelf, index) RecordLockEvent(drinker, type, shelf, index)
+#else
+	#define RECORD_LOCK_EVENT(drinker, type, shelf, index)
+#endif
 
-		// We want to generate values in the range of [min, max] (inclusive) with a uniform distribution.
-		distro = std::uniform_int_distribution<int>(min, max);
+// Pins the calling thread to one CPU. Returns false if it can't be done.
+#if defined _WIN32
+	static bool PinToCpu(int cpu)
+	{
+		return cpu < 64 && SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
 	}
-
-	int operator()()
+#elif defined __linux__
+	static bool PinToCpu(int cpu)
+	{
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+		return sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+	}
+#else
+	static bool PinToCpu(int cpu)
 	{
-		return distro(randEngine);
+		return false;
 	}
+#endif
 
-private:
-	std::random_device randDevice;
-	std::mt19937 randEngine;
-	std::uniform_int_distribution<int> distro;
-};
+// Index of the lowest set bit, bits must not be 0
+#if defined _MSC_VER
+	#include <intrin.h>
+	static int CountTrailingZeros(unsigned long long bits)
+	{
+		// _BitScanForward64 does not exist on Win32 so scan the two halves
+		unsigned long index;
+		if (_BitScanForward(&index, (unsigned long)bits))
+		{
+			return (int)index;
+		}
+		_BitScanForward(&index, (unsigned long)(bits >> 32));
+		return (int)index + 32;
+	}
+#else
+	static int CountTrailingZeros(unsigned long long bits)
+	{
+		return __builtin_ctzll(bits);
+	}
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////////
 // The various types of resources that can be found in the pool. An 'Unknown'
@@ -58,21 +101,157 @@ enum class ResourceType
 };
 
 ///////////////////////////////////////////////////////////////////////////////////
-// Contains all resource-specific data. Each resource has its own unique mutex.
+// The ways a drinker can get hold of a bottle and an opener.
 ///////////////////////////////////////////////////////////////////////////////////
-struct Resource
+enum class AcquireMode
+{
+	// Block on a random resource, then try_lock every resource of the other type
+	//   and give the first one back if none is free.
+	Scan,
+	// Claim a free bottle and a free opener together from the occupancy bitmaps.
+	//   The drinker gets both or neither and never blocks holding one.
+	Pair,
+	// Queue up and wait for the broker thread to hand over a bottle and an opener
+	//   taken from the free lists. Every attempt succeeds until drinking stops.
+	Broker,
+	// Block on a random resource, then wait for a random resource of the other type
+	//   while still holding the first. This can deadlock, which the lock graph 
+	//   checker reports. The wait gives up once drinking stops.
+	Block,
+	// Queue up for the broker like Broker mode, but the broker serves the drinker
+	//   with the earliest aged deadline instead of the longest waiting one. Every 
+	//   drink already taken pushes the deadline back, so drinkers who drank least go
+	//   first, and waiting long enough beats any number of drinks.
+	Aging,
+	// Claim a pair from the occupancy bitmaps like Pair mode, but each shelf's bitmap
+	//   is split into one shard of words per core. A drinker looks in its home shard
+	//   first and only steals from the shards after it when the home shard has 
+	//   nothing free, so drinkers on different cores mostly touch different words.
+	Sharded
+};
+
+// Microseconds an Aging drinker's deadline is pushed back per drink it has taken
+const long long AgingMicrosecondsPerDrink = 50000;
+
+// Seconds a run measured in drinks waits without a single drink before giving up
+const int StalledRunSeconds = 10;
+
+#if ENABLE_LOCK_GRAPH
+///////////////////////////////////////////////////////////////////////////////////
+// The things a drinker can do with a resource mutex.
+///////////////////////////////////////////////////////////////////////////////////
+enum class LockEventType
+{
+	// Started waiting for the mutex.
+	Waiting,
+	// Stopped waiting for the mutex without getting it.
+	GaveUp,
+	// Locked the mutex.
+	Acquired,
+	// Unlocked the mutex.
+	Released
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+// One entry in a drinker's lock event ring.
+///////////////////////////////////////////////////////////////////////////////////
+struct LockEvent
+{
+	// What the drinker did.
+	LockEventType type;
+	// ID of the resource.
+	int resourceId;
+	// The lock count of the resource while the drinker held it. Orders the
+	//   Acquired and Released events of different drinkers on one resource. 
+	int generation;
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+// Lock events of one drinker, written only by the drinker and read only by the
+//   lock graph checker.
+///////////////////////////////////////////////////////////////////////////////////
+struct LockEventRing
+{
+	// Number of events the ring holds. Must be a power of 2.
+	static const unsigned Size = 256;
+	// The events, indexed by sequence number modulo Size.
+	LockEvent events[Size];
+	// Sequence number of the next event the drinker writes.
+	std::atomic<unsigned> head;
+	// Sequence number of the next event the checker reads.
+	std::atomic<unsigned> tail;
+};
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////
+// How long a drinker waited for each bottle and opener, from its first try to 
+//   holding both. Waits under 4 microseconds get a bucket each, above that every
+//   power of two is split into 4 buckets, so a wait is known to within 25%.
+///////////////////////////////////////////////////////////////////////////////////
+struct WaitHistogram
+{
+	// Number of buckets, enough for waits of over an hour.
+	static const int BucketCount = 128;
+	// Number of waits in each bucket. Only the drinker writes, atomic so a timed
+	//   run can read it while the drinker runs.
+	std::atomic<int> counts[BucketCount];
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+// A drinker waiting for the broker in Aging mode.
+///////////////////////////////////////////////////////////////////////////////////
+struct AgingEntry
+{
+	// When the drinker started waiting, pushed back by the drinks it has taken.
+	//   Lowest goes first.
+	long long deadline;
+	// The drinker.
+	struct Drinker *drinker;
+
+	bool operator>(const AgingEntry &other) const
+	{
+		return deadline > other.deadline;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+// Contains all resources of one type as parallel arrays, indexed by a resource's
+//   index on the shelf. Each resource has its own unique mutex, and a bit in the
+//   occupancy bitmap that is set while a drinker holds it.
+///////////////////////////////////////////////////////////////////////////////////
+struct ResourceShelf
 {
-	// ID of the resource. For output purposes only.
-	int id;
-	// Number of times the resource has been 'used'. A resource is 'used' whenever
-	//   a drinker drinks.
-	int useCount;
-	// Number of times the resource has been locked.
-	int lockCount;
 	// The resource type. Either a Bottle or an Opener
 	ResourceType type;
-	// The resource mutex.
-	std::mutex resourceMutex;
+	// Number of resources on the shelf.
+	int count;
+	// ID of each resource. For output purposes only.
+	int *ids;
+	// Number of times each resource has been 'used'. A resource is 'used' whenever
+	//   a drinker drinks. Atomic so a timed run can read it while drinkers run.
+	std::atomic<int> *useCounts;
+	// Number of times each resource has been locked.
+	std::atomic<int> *lockCounts;
+	// Milliseconds each resource has been drunk from.
+	std::atomic<long long> *busyTimes;
+	// The mutex of each resource.
+	std::mutex *locks;
+	// Number of words in the occupancy bitmap.
+	int wordCount;
+	// One bit per resource, set while a drinker holds it. The bits past the last
+	//   resource are always set. In Pair and Sharded modes the bit is what claims the
+	//   resource, otherwise it follows the mutex so free ones can be found a word at 
+	//   a time.
+	std::atomic<unsigned long long> *occupied;
+	// Index of the first free resource, or -1 if none is free. Only used in Broker mode.
+	std::atomic<int> freeHead;
+	// Per resource, the next resource in the free list. Only used in Broker mode.
+	int *nextFree;
+	// Number of drinkers waiting on the waitCondition. Only used in Scan mode.
+	std::atomic<int> waiterCount;
+	// The condition variable drinkers wait on until a resource on this shelf is
+	//   released. Used with the poolMutex. Only used in Scan mode.
+	std::condition_variable waitCondition;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////
@@ -111,33 +290,76 @@ struct ResourcePool
 	std::mutex poolMutex;
 	// The condition variable used to notify and wait for changes in the resource pool.
 	std::condition_variable poolCondition;
-	// An array of resources
-	Resource *resources;
+	// The bottles. Their ids come before every opener id.
+	ResourceShelf bottles;
+	// The openers.
+	ResourceShelf openers;
+	// How drinkers acquire their resources.
+	AcquireMode acquireMode;
+	// Number of shards each shelf's bitmap is split into. Sharded mode.
+	int shardCount;
+	// Number of CPUs drinker threads are pinned to, 0 if they aren't pinned.
+	int pinnedCpus;
+	// The mutex used to control access to the waiting drinkers and the stopBrokerFlag.
+	std::mutex brokerMutex;
+	// The condition variable the broker waits on for a drinker and a pair to match.
+	std::condition_variable brokerCondition;
+	// Ring of drinkers waiting for the broker, oldest first. Sized for every drinker.
+	//   Broker mode.
+	struct Drinker **waitingDrinkers;
+	// Index of the oldest waiting drinker in the ring.
+	int waitingHead;
+	// Drinkers waiting for the broker, earliest deadline first. Aging mode.
+	std::priority_queue<AgingEntry, std::vector<AgingEntry>, std::greater<AgingEntry> > agingDrinkers;
+	// Number of drinkers waiting for the broker, in either mode.
+	int waitingCount;
+	// Flag to break the broker and its waiting drinkers out of their loops.
+	bool stopBrokerFlag;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////
-// Contains all drinker specific information. Each drinker has a pointer to an opener
-//   and a pointer to a bottle. When the drinker goes to drink it will use these two
+// Contains all drinker specific information. Each drinker has the index of an opener
+//   and the index of a bottle. When the drinker goes to drink it will use these two
 //   resources.
 ///////////////////////////////////////////////////////////////////////////////////
 struct Drinker 
 {
 	// ID of the drinker. For output purposes only.
 	int id;
-	// Number of times the drinker has taken a drink.
-	int drinkCount;
+	// Number of times the drinker has taken a drink. Atomic so a timed run can read
+	//   it while the drinker runs.
+	std::atomic<int> drinkCount;
 	// Number of resources the drinker has Tried to lock
-	int resourceTryCount;
-	// A pointer to a bottle resource to use when drinking.
-	Resource *bottle;
-	// A pointer to an opener resource to use when drinking.
-	Resource *opener;
+	std::atomic<int> resourceTryCount;
+	// The shard the drinker claims from first, and the CPU it runs on if pinned.
+	int homeShard;
+	// Number of pairs the drinker claimed with a bottle or an opener from outside its
+	//   home shard. Sharded mode.
+	std::atomic<int> stealCount;
+	// Index of the bottle to use when drinking, -1 if the drinker has none.
+	int bottle;
+	// Index of the opener to use when drinking, -1 if the drinker has none.
+	int opener;
+	// The shelf the drinker found nothing free on in its last failed Scan attempt.
+	ResourceShelf *wantedShelf;
+	// Microseconds on the run's clock when the drinker started waiting for its next
+	//   bottle and opener, -1 while it isn't waiting.
+	long long waitStart;
+	// How long the drinker waited for each drink.
+	WaitHistogram waits;
 	// A pointer to the pool of drinkers
 	DrinkerPool *drinkerPool;
 	// A pointer to the pool of resources
 	ResourcePool *resourcePool;
 	// Random number generator for this thread
-	UniformRandInt myRand;
+	FastRand myRand;
+	// The condition variable the broker notifies once it has handed this drinker a
+	//   bottle and an opener. Used with the brokerMutex.
+	std::condition_variable pairCondition;
+#if ENABLE_LOCK_GRAPH
+	// What this drinker did with resource mutexes, for the lock graph checker.
+	LockEventRing lockEvents;
+#endif
 };
 
 ///////////////////////////////////////////////////////////////////////////////////
@@ -149,6 +371,318 @@ void Pause()
 	getchar();
 }
 
+///////////////////////////////////////////////////////////////////////////////////
+// Gets the wait histogram bucket a wait falls in.
+//
+// Arguments:
+//   microseconds - Length of the wait
+//
+// Return:
+//   Index of the bucket
+///////////////////////////////////////////////////////////////////////////////////
+int WaitBucket(long long microseconds)
+{
+	if (microseconds < 4)
+	{
+		return (microseconds > 0) ? (int)microseconds : 0;
+	}
+
+	int power = 2;
+	while ((microseconds >> (power + 1)) != 0)
+	{
+		power++;
+	}
+
+	int bucket = 4 + (power - 2) * 4 + (int)((microseconds >> (power - 2)) & 3);
+	return (bucket < WaitHistogram::BucketCount) ? bucket : WaitHistogram::BucketCount - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Gets the end of a wait histogram bucket.
+//
+// Arguments:
+//   bucket - Index of the bucket
+//
+// Return:
+//   Microseconds every wait in the bucket is shorter than
+///////////////////////////////////////////////////////////////////////////////////
+long long WaitBucketLimit(int bucket)
+{
+	if (bucket < 4)
+	{
+		return bucket + 1;
+	}
+
+	int power = 2 + (bucket - 4) / 4;
+	return (5ll + ((bucket - 4) % 4)) << (power - 2);
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Gets the time on a steady clock for timing waits of threaded drinkers.
+//
+// Return:
+//   Microseconds since the clock's epoch
+///////////////////////////////////////////////////////////////////////////////////
+long long MicrosecondsNow()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Starts timing a wait for a bottle and an opener, unless the drinker is already
+//   waiting since an earlier failed try.
+//
+// Arguments:
+//   currentDrinker - The current drinker
+//   now - Microseconds on the run's clock
+///////////////////////////////////////////////////////////////////////////////////
+void StartWaiting(Drinker *currentDrinker, long long now)
+{
+	if (currentDrinker->waitStart == -1)
+	{
+		currentDrinker->waitStart = now;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Adds the wait that just ended to the drinker's wait histogram. The drinker must 
+//   be holding a bottle and an opener.
+//
+// Arguments:
+//   currentDrinker - The current drinker
+//   now - Microseconds on the run's clock
+///////////////////////////////////////////////////////////////////////////////////
+void StopWaiting(Drinker *currentDrinker, long long now)
+{
+	currentDrinker->waits.counts[WaitBucket(now - currentDrinker->waitStart)]++;
+	currentDrinker->waitStart = -1;
+}
+
+#if ENABLE_LOCK_GRAPH
+///////////////////////////////////////////////////////////////////////////////////
+// Adds an event to the drinker's lock event ring. Waits for the checker if the 
+//   ring is full, since a lost event would leave the graph wrong.
+//
+// Arguments:
+//   currentDrinker - The current drinker
+//   type - What the drinker did
+//   shelf - The shelf holding the resource
+//   index - Index of the resource on the shelf
+///////////////////////////////////////////////////////////////////////////////////
+void RecordLockEvent(Drinker *currentDrinker, LockEventType type, const ResourceShelf *shelf, int index)
+{
+	LockEventRing *ring = &currentDrinker->lockEvents;
+	unsigned head = ring->head.load(std::memory_order_relaxed);
+
+	while (head - ring->tail.load(std::memory_order_acquire) == LockEventRing::Size)
+	{
+		std::this_thread::yield();
+	}
+
+	LockEvent *lockEvent = &ring->events[head % LockEventRing::Size];
+	lockEvent->type = type;
+	lockEvent->resourceId = shelf->ids[index];
+	lockEvent->generation = (type == LockEventType::Acquired || type == LockEventType::Released) ? shelf->lockCounts[index].load() : 0;
+	ring->head.store(head + 1, std::memory_order_release);
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////
+// Allocates a shelf of resources. Every resource starts out free and on the free
+//   list, lowest index first.
+//
+// Arguments:
+//   shelf - The shelf to set up
+//   type - The type of resource on the shelf
+//   firstId - ID of the first resource on the shelf
+//   count - Number of resources on the shelf
+///////////////////////////////////////////////////////////////////////////////////
+void InitShelf(ResourceShelf *shelf, ResourceType type, int firstId, int count)
+{
+	shelf->type = type;
+	shelf->count = count;
+	shelf->ids = new int[count];
+	shelf->useCounts = new std::atomic<int>[count];
+	shelf->lockCounts = new std::atomic<int>[count];
+	shelf->busyTimes = new std::atomic<long long>[count];
+	shelf->locks = new std::mutex[count];
+	shelf->wordCount = (count + 63) / 64;
+	shelf->occupied = new std::atomic<unsigned long long>[shelf->wordCount];
+	shelf->freeHead = (count > 0) ? 0 : -1;
+	shelf->nextFree = new int[count];
+	shelf->waiterCount = 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		shelf->ids[i] = firstId + i;
+		shelf->useCounts[i] = 0;
+		shelf->lockCounts[i] = 0;
+		shelf->busyTimes[i] = 0;
+		shelf->nextFree[i] = (i + 1 < count) ? i + 1 : -1;
+	}
+
+	for (int i = 0; i < shelf->wordCount; i++)
+	{
+		shelf->occupied[i] = 0;
+	}
+
+	// Mark the bits past the last resource as held so they are never found free
+	if ((count % 64) != 0)
+	{
+		shelf->occupied[shelf->wordCount - 1] = ~0ull << (count % 64);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Frees the memory allocated by InitShelf.
+//
+// Arguments:
+//   shelf - The shelf to free
+///////////////////////////////////////////////////////////////////////////////////
+void FreeShelf(ResourceShelf *shelf)
+{
+	delete[] shelf->ids;
+	delete[] shelf->useCounts;
+	delete[] shelf->lockCounts;
+	delete[] shelf->busyTimes;
+	delete[] shelf->locks;
+	delete[] shelf->occupied;
+	delete[] shelf->nextFree;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Sets a resource's bit in the occupancy bitmap.
+//
+// Arguments:
+//   shelf - The shelf holding the resource
+//   index - Index of the resource on the shelf
+//
+// Return:
+//   True if the bit was clear, so the caller now holds the resource
+///////////////////////////////////////////////////////////////////////////////////
+bool MarkOccupied(ResourceShelf *shelf, int index)
+{
+	unsigned long long bit = 1ull << (index % 64);
+	return (shelf->occupied[index / 64].fetch_or(bit) & bit) == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Clears a resource's bit in the occupancy bitmap.
+//
+// Arguments:
+//   shelf - The shelf holding the resource
+//   index - Index of the resource on the shelf
+///////////////////////////////////////////////////////////////////////////////////
+void MarkFree(ResourceShelf *shelf, int index)
+{
+	shelf->occupied[index / 64].fetch_and(~(1ull << (index % 64)));
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Puts a resource on its shelf's free list. Any thread may push.
+//
+// Arguments:
+//   shelf - The shelf holding the resource
+//   index - Index of the resource to push
+///////////////////////////////////////////////////////////////////////////////////
+void PushFree(ResourceShelf *shelf, int index)
+{
+	int first = shelf->freeHead.load();
+	do
+	{
+		shelf->nextFree[index] = first;
+	} while (shelf->freeHead.compare_exchange_weak(first, index) == false);
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Takes a resource off a shelf's free list. Only the broker thread pops, so a 
+//   resource at the head can't be popped and pushed back between reading its link
+//   and the CAS.
+//
+// Arguments:
+//   shelf - The shelf to take from
+//
+// Return:
+//   Index of the resource taken, or -1 if the list is empty
+///////////////////////////////////////////////////////////////////////////////////
+int PopFree(ResourceShelf *shelf)
+{
+	int first = shelf->freeHead.load();
+	while (first != -1 && shelf->freeHead.compare_exchange_weak(first, shelf->nextFree[first]) == false)
+	{
+	}
+	return first;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Wakes one drinker waiting for a resource on the shelf, if there is one. The
+//   released resource must already be marked free, so a drinker that starts 
+//   waiting after the waiterCount check sees it and doesn't wait.
+//
+// Arguments:
+//   pool - The pool of resources
+//   shelf - The shelf a resource was released to
+///////////////////////////////////////////////////////////////////////////////////
+void WakeWaiter(ResourcePool *pool, ResourceShelf *shelf)
+{
+	if (shelf->waiterCount.load() > 0)
+	{
+		std::lock_guard<std::mutex> poolLock(pool->poolMutex);
+		shelf->waitCondition.notify_one();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Gives the bottle and opener held by the drinker back to the pool.
+//
+// Arguments:
+//   currentDrinker - The current drinker
+///////////////////////////////////////////////////////////////////////////////////
+void ReleaseResources(Drinker *currentDrinker)
+{
+	ResourcePool *pool = currentDrinker->resourcePool;
+
+	if (pool->acquireMode == AcquireMode::Pair || pool->acquireMode == AcquireMode::Sharded)
+	{
+		MarkFree(&pool->bottles, currentDrinker->bottle);
+		MarkFree(&pool->openers, currentDrinker->opener);
+
+		// A failed pair attempt never held anything, so only this wakes anyone, and
+		//   one pair is enough for one waiter. Notifying under the poolMutex means a
+		//   drinker that just failed is either waiting already or sees the freed pair
+		//   when it checks before waiting.
+		std::lock_guard<std::mutex> poolLock(pool->poolMutex);
+		pool->poolCondition.notify_one();
+		return;
+	}
+
+	if (pool->acquireMode == AcquireMode::Broker || pool->acquireMode == AcquireMode::Aging)
+	{
+		PushFree(&pool->bottles, currentDrinker->bottle);
+		PushFree(&pool->openers, currentDrinker->opener);
+
+		// Take the brokerMutex so a broker that just found the lists empty is already
+		//   waiting when it gets notified.
+		std::lock_guard<std::mutex> brokerLock(pool->brokerMutex);
+		pool->brokerCondition.notify_one();
+		return;
+	}
+
+	// Clear the bits before unlocking. Once a mutex is unlocked another drinker can
+	//   lock it and set its bit, and clearing the bit after that would wipe theirs.
+	MarkFree(&pool->bottles, currentDrinker->bottle);
+	MarkFree(&pool->openers, currentDrinker->opener);
+	RECORD_LOCK_EVENT(currentDrinker, LockEventType::Released, &pool->bottles, currentDrinker->bottle);
+	RECORD_LOCK_EVENT(currentDrinker, LockEventType::Released, &pool->openers, currentDrinker->opener);
+	pool->bottles.locks[currentDrinker->bottle].unlock();
+	pool->openers.locks[currentDrinker->opener].unlock();
+
+	// The freed bottle is for someone holding an opener, and the freed opener for
+	//   someone holding a bottle
+	WakeWaiter(pool, &pool->bottles);
+	WakeWaiter(pool, &pool->openers);
+}
+
 ///////////////////////////////////////////////////////////////////////////////////
 // Causes the specified drinker to drink.
 //
@@ -157,20 +691,21 @@ void Pause()
 ///////////////////////////////////////////////////////////////////////////////////
 void Drink(Drinker *currentDrinker)
 {
-	int drinkTime = 20 + (currentDrinker->myRand() % 20);
-	int drunkTime = 40 + (currentDrinker->myRand() % 10);
-	int bathroomTime = 60 + (currentDrinker->myRand() % 10);
+	int drinkTime = 20 + currentDrinker->myRand.Bounded(20);
+	int drunkTime = 40 + currentDrinker->myRand.Bounded(10);
+	int bathroomTime = 60 + currentDrinker->myRand.Bounded(10);
 
-	currentDrinker->bottle->useCount++;
-	currentDrinker->opener->useCount++;
+	currentDrinker->resourcePool->bottles.useCounts[currentDrinker->bottle]++;
+	currentDrinker->resourcePool->openers.useCounts[currentDrinker->opener]++;
+	currentDrinker->resourcePool->bottles.busyTimes[currentDrinker->bottle] += drinkTime;
+	currentDrinker->resourcePool->openers.busyTimes[currentDrinker->opener] += drinkTime;
 
 	std::this_thread::sleep_for(std::chrono::milliseconds(drinkTime)); 
 
 	// We are done drinking so release the bottle and opener
-	currentDrinker->bottle->resourceMutex.unlock();
-	currentDrinker->opener->resourceMutex.unlock();
-	currentDrinker->bottle = nullptr;
-	currentDrinker->opener = nullptr;
+	ReleaseResources(currentDrinker);
+	currentDrinker->bottle = -1;
+	currentDrinker->opener = -1;
 	currentDrinker->drinkCount++;
 
 	if ((currentDrinker->drinkCount % 5) ==  0)
@@ -184,44 +719,368 @@ void Drink(Drinker *currentDrinker)
 }
 
 ///////////////////////////////////////////////////////////////////////////////////
-// Attempts to acquire a bottle and an opener resource.
+// Finds a free resource in a shelf's occupancy bitmap, starting at a word and bit
+//   so drinkers spread out over the shelf instead of all wanting the lowest index.
+//
+// Arguments:
+//   shelf - The shelf to look on
+//   startWord - Word to look in first
+//   startBit - Bit to look from first in every word
+//
+// Return:
+//   Index of the free resource, or -1 if every one is held
+///////////////////////////////////////////////////////////////////////////////////
+int FindFreeResource(ResourceShelf *shelf, int startWord, int startBit)
+{
+	for (int i = 0; i < shelf->wordCount; i++)
+	{
+		int w = (startWord + i) % shelf->wordCount;
+		unsigned long long freeBits = ~shelf->occupied[w].load();
+
+		if (freeBits != 0)
+		{
+			unsigned long long fromStart = freeBits & (~0ull << startBit);
+			return (w * 64) + CountTrailingZeros((fromStart != 0) ? fromStart : freeBits);
+		}
+	}
+
+	return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Checks if a bottle and an opener are free at the moment.
+//
+// Arguments:
+//   pool - The pool of resources
+//
+// Return:
+//   True if a pair could be claimed right now
+///////////////////////////////////////////////////////////////////////////////////
+bool IsPairFree(ResourcePool *pool)
+{
+	return FindFreeResource(&pool->bottles, 0, 0) != -1 &&
+		FindFreeResource(&pool->openers, 0, 0) != -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Gets the bitmap words of a shard. Shards split the words as evenly as they can,
+//   and when there are more shards than words several shards share one word.
+//
+// Arguments:
+//   shelf - The shelf
+//   shard - The shard
+//   shardCount - Number of shards the shelf is split into
+//   firstWord - Set to the first word of the shard
+//   endWord - Set to the word after the shard's last word
+///////////////////////////////////////////////////////////////////////////////////
+void GetShardWords(const ResourceShelf *shelf, int shard, int shardCount, int *firstWord, int *endWord)
+{
+	*firstWord = (int)((long long)shard * shelf->wordCount / shardCount);
+	*endWord = (int)((long long)(shard + 1) * shelf->wordCount / shardCount);
+
+	if (*endWord == *firstWord)
+	{
+		*endWord = *firstWord + 1;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Attempts to acquire a bottle and an opener resource together.
 //
 // Arguments:
 //   currentDrinker - The current drinker
 //
 // Return:
-//   True if both resources were successfully acquired by the drinker
+//   True if both resources were acquired, false if no bottle and opener were 
+//   free at the same time. The drinker never holds just one of them afterwards.
 ///////////////////////////////////////////////////////////////////////////////////
-bool TryToGetResources(Drinker *currentDrinker)
+bool TryToGetPair(Drinker *currentDrinker)
 {
-	int totalResources = currentDrinker->resourcePool->totalResources;
-	int trying = currentDrinker->myRand() % totalResources;
+	ResourcePool *pool = currentDrinker->resourcePool;
 
 	currentDrinker->resourceTryCount++;
 
-	Resource *firstResource = &currentDrinker->resourcePool->resources[trying];
-	firstResource->resourceMutex.lock();
-	firstResource->lockCount++; 
-
-	if (firstResource->type == ResourceType::Bottle)
+	if (pool->bottles.count == 0 || pool->openers.count == 0)
 	{
-		currentDrinker->bottle = firstResource;
+		return false;
 	}
-	else
+
+	int bottleWord = currentDrinker->myRand.Bounded(pool->bottles.wordCount);
+	int openerWord = currentDrinker->myRand.Bounded(pool->openers.wordCount);
+	int startBit = currentDrinker->myRand.Bounded(64);
+	int bottleFirst = 0;
+	int bottleEnd = pool->bottles.wordCount;
+	int openerFirst = 0;
+	int openerEnd = pool->openers.wordCount;
+
+	// Start in the home shard. The search goes on into the shards after it, so the
+	//   home shard is always searched first.
+	if (pool->acquireMode == AcquireMode::Sharded)
 	{
-		currentDrinker->opener = firstResource;
+		GetShardWords(&pool->bottles, currentDrinker->homeShard, pool->shardCount, &bottleFirst, &bottleEnd);
+		GetShardWords(&pool->openers, currentDrinker->homeShard, pool->shardCount, &openerFirst, &openerEnd);
+		bottleWord = bottleFirst + currentDrinker->myRand.Bounded(bottleEnd - bottleFirst);
+		openerWord = openerFirst + currentDrinker->myRand.Bounded(openerEnd - openerFirst);
 	}
 
 	///////////////////////////////////////////////////////////////////////////////////
-	//    Acquire the second resource. The first resource has already been acquired.
-	//    Each resource has a mutex that will determine which thread 'owns' the specified 
-	//    resource. If the mutex is not locked then that resource is free to be acquire by a 
-	//    drinker.
-	//    Each resource also has a lock count and each drinker has its own a try count, both 
-	//    of which should always represent the number of times a resource has been locked
-	//    or the number of times the drinker has tried to lock a resource.
-	//
-	// Example of the potential deadlock with two threads and two resources:
+	//    Claims always go bottle first, then opener. The bottle is given straight back
+	//    if the opener was taken in the meantime, so nobody ever waits while holding
+	//    something.
+	///////////////////////////////////////////////////////////////////////////////////
+	while (true)
+	{
+		int bottle = FindFreeResource(&pool->bottles, bottleWord, startBit);
+		int opener = FindFreeResource(&pool->openers, openerWord, startBit);
+
+		if (bottle == -1 || opener == -1)
+		{
+			return false;
+		}
+
+		if (MarkOccupied(&pool->bottles, bottle) == false)
+		{
+			continue;
+		}
+
+		if (MarkOccupied(&pool->openers, opener) == false)
+		{
+			MarkFree(&pool->bottles, bottle);
+			continue;
+		}
+
+		currentDrinker->bottle = bottle;
+		currentDrinker->opener = opener;
+		pool->bottles.lockCounts[bottle]++;
+		pool->openers.lockCounts[opener]++;
+
+		if (bottle / 64 < bottleFirst || bottle / 64 >= bottleEnd || opener / 64 < openerFirst || opener / 64 >= openerEnd)
+		{
+			currentDrinker->stealCount++;
+		}
+		return true;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Adds a drinker to the drinkers waiting for the broker. In Broker mode it goes to
+//   the back of the ring, in Aging mode it is ordered by its deadline. Call with the
+//   brokerMutex held, or from the simulation.
+//
+// Arguments:
+//   pool - The pool of resources
+//   currentDrinker - The drinker to add. Its waitStart must be set.
+//   totalDrinkers - Size of the ring of waiting drinkers
+///////////////////////////////////////////////////////////////////////////////////
+void QueueForBroker(ResourcePool *pool, Drinker *currentDrinker, int totalDrinkers)
+{
+	if (pool->acquireMode == AcquireMode::Aging)
+	{
+		AgingEntry entry;
+		entry.deadline = currentDrinker->waitStart + currentDrinker->drinkCount.load() * AgingMicrosecondsPerDrink;
+		entry.drinker = currentDrinker;
+		pool->agingDrinkers.push(entry);
+	}
+	else
+	{
+		pool->waitingDrinkers[(pool->waitingHead + pool->waitingCount) % totalDrinkers] = currentDrinker;
+	}
+	pool->waitingCount++;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Takes the drinker the broker serves next off the drinkers waiting for it. Call 
+//   with the brokerMutex held, or from the simulation.
+//
+// Arguments:
+//   pool - The pool of resources. At least one drinker must be waiting.
+//   totalDrinkers - Size of the ring of waiting drinkers
+//
+// Return:
+//   The drinker taken
+///////////////////////////////////////////////////////////////////////////////////
+Drinker *NextForBroker(ResourcePool *pool, int totalDrinkers)
+{
+	Drinker *nextDrinker;
+
+	if (pool->acquireMode == AcquireMode::Aging)
+	{
+		nextDrinker = pool->agingDrinkers.top().drinker;
+		pool->agingDrinkers.pop();
+	}
+	else
+	{
+		nextDrinker = pool->waitingDrinkers[pool->waitingHead];
+		pool->waitingHead = (pool->waitingHead + 1) % totalDrinkers;
+	}
+	pool->waitingCount--;
+	return nextDrinker;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Queues the drinker for the broker and waits until it has been handed a bottle 
+//   and an opener.
+//
+// Arguments:
+//   currentDrinker - The current drinker
+//
+// Return:
+//   True if both resources were handed over, false if the broker stopped first
+///////////////////////////////////////////////////////////////////////////////////
+bool WaitForBroker(Drinker *currentDrinker)
+{
+	ResourcePool *pool = currentDrinker->resourcePool;
+	int totalDrinkers = currentDrinker->drinkerPool->totalDrinkers;
+
+	currentDrinker->resourceTryCount++;
+
+	std::unique_lock<std::mutex> brokerLock(pool->brokerMutex);
+	if (pool->stopBrokerFlag)
+	{
+		return false;
+	}
+
+	QueueForBroker(pool, currentDrinker, totalDrinkers);
+	pool->brokerCondition.notify_one();
+
+	currentDrinker->pairCondition.wait(brokerLock, [&](){return currentDrinker->bottle != -1 || pool->stopBrokerFlag; });
+	return currentDrinker->bottle != -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Entry point for the broker thread. Hands the next free bottle and opener to the
+//   drinker that has been waiting longest, or in Aging mode to the one with the 
+//   earliest deadline, until the stopBrokerFlag has been set.
+//
+// Arguments:
+//   pool - The pool of resources
+//   totalDrinkers - Size of the ring of waiting drinkers
+///////////////////////////////////////////////////////////////////////////////////
+void BrokerThreadEntrypoint(ResourcePool *pool, int totalDrinkers)
+{
+	std::unique_lock<std::mutex> brokerLock(pool->brokerMutex);
+
+	while (true)
+	{
+		pool->brokerCondition.wait(brokerLock, [pool](){
+			return pool->stopBrokerFlag ||
+				(pool->waitingCount > 0 && pool->bottles.freeHead.load() != -1 && pool->openers.freeHead.load() != -1); });
+
+		if (pool->stopBrokerFlag)
+		{
+			break;
+		}
+
+		// Nobody else pops, so both lists still have a resource on them
+		Drinker *nextDrinker = NextForBroker(pool, totalDrinkers);
+
+		nextDrinker->bottle = PopFree(&pool->bottles);
+		nextDrinker->opener = PopFree(&pool->openers);
+		pool->bottles.lockCounts[nextDrinker->bottle]++;
+		pool->openers.lockCounts[nextDrinker->opener]++;
+		nextDrinker->pairCondition.notify_one();
+	}
+
+	// Let every drinker still waiting go
+	while (pool->waitingCount > 0)
+	{
+		NextForBroker(pool, totalDrinkers)->pairCondition.notify_one();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Waits for a resource mutex until it is locked or drinking stops. Polls with 
+//   try_lock so a drinker caught in a deadlock can still be stopped.
+//
+// Arguments:
+//   currentDrinker - The current drinker
+//   shelf - The shelf holding the resource
+//   index - Index of the resource on the shelf
+//
+// Return:
+//   True if the mutex was locked, false if drinking stopped first
+///////////////////////////////////////////////////////////////////////////////////
+bool WaitForResource(Drinker *currentDrinker, ResourceShelf *shelf, int index)
+{
+	RECORD_LOCK_EVENT(currentDrinker, LockEventType::Waiting, shelf, index);
+
+	while (shelf->locks[index].try_lock() == false)
+	{
+		currentDrinker->drinkerPool->startingGunMutex.lock();
+		bool stopped = currentDrinker->drinkerPool->stopDrinkingFlag;
+		currentDrinker->drinkerPool->startingGunMutex.unlock();
+
+		if (stopped)
+		{
+			RECORD_LOCK_EVENT(currentDrinker, LockEventType::GaveUp, shelf, index);
+			return false;
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Attempts to acquire a bottle and an opener resource.
+//
+// Arguments:
+//   currentDrinker - The current drinker
+//
+// Return:
+//   True if both resources were successfully acquired by the drinker
+///////////////////////////////////////////////////////////////////////////////////
+bool TryToGetResources(Drinker *currentDrinker)
+{
+	ResourcePool *pool = currentDrinker->resourcePool;
+
+	if (pool->acquireMode == AcquireMode::Pair || pool->acquireMode == AcquireMode::Sharded)
+	{
+		return TryToGetPair(currentDrinker);
+	}
+
+	if (pool->acquireMode == AcquireMode::Broker || pool->acquireMode == AcquireMode::Aging)
+	{
+		return WaitForBroker(currentDrinker);
+	}
+
+	int trying = currentDrinker->myRand.Bounded(pool->totalResources);
+
+	currentDrinker->resourceTryCount++;
+
+	ResourceShelf *firstShelf = &pool->bottles;
+	ResourceShelf *secondShelf = &pool->openers;
+	int *firstHeld = &currentDrinker->bottle;
+	int *secondHeld = &currentDrinker->opener;
+
+	if (trying >= pool->bottles.count)
+	{
+		trying -= pool->bottles.count;
+		firstShelf = &pool->openers;
+		secondShelf = &pool->bottles;
+		firstHeld = &currentDrinker->opener;
+		secondHeld = &currentDrinker->bottle;
+	}
+
+	RECORD_LOCK_EVENT(currentDrinker, LockEventType::Waiting, firstShelf, trying);
+	firstShelf->locks[trying].lock();
+	firstShelf->lockCounts[trying]++; 
+	RECORD_LOCK_EVENT(currentDrinker, LockEventType::Acquired, firstShelf, trying);
+	MarkOccupied(firstShelf, trying);
+	*firstHeld = trying;
+
+	///////////////////////////////////////////////////////////////////////////////////
+	//    Acquire the second resource. The first resource has already been acquired.
+	//    Each resource has a mutex that will determine which thread 'owns' the specified 
+	//    resource. If the mutex is not locked then that resource is free to be acquire by a 
+	//    drinker. The occupancy bitmap of the other shelf tells which mutexes are worth 
+	//    trying, 64 resources per word, without touching the others.
+	//    Each resource also has a lock count and each drinker has its own a try count, both 
+	//    of which should always represent the number of times a resource has been locked
+	//    or the number of times the drinker has tried to lock a resource.
+	//
+	// Example of the potential deadlock with two threads and two resources:
 	//   * Thread1 locks Resource1
 	//   * Thread2 locks Resource2
 	//   * Thread1 locks Resource2 and blocks because Thread2 has it locked.
@@ -236,159 +1095,1250 @@ bool TryToGetResources(Drinker *currentDrinker)
 	//  No deadlock.
 	///////////////////////////////////////////////////////////////////////////////////
 
-	for (int i = 0; i < totalResources; i++)
+	if (pool->acquireMode == AcquireMode::Block)
 	{
-		Resource *second = &currentDrinker->resourcePool->resources[i];
-		if (firstResource->type == ResourceType::Bottle)
+		int second = (secondShelf->count > 0) ? currentDrinker->myRand.Bounded(secondShelf->count) : -1;
+
+		if (second != -1 && WaitForResource(currentDrinker, secondShelf, second) == true)
+		{
+			secondShelf->lockCounts[second]++;
+			RECORD_LOCK_EVENT(currentDrinker, LockEventType::Acquired, secondShelf, second);
+			MarkOccupied(secondShelf, second);
+			*secondHeld = second;
+			return true;
+		}
+	}
+	else
+	{
+		for (int w = 0; w < secondShelf->wordCount; w++)
 		{
-			if (second->type == ResourceType::Opener && second->resourceMutex.try_lock() == true)
+			unsigned long long freeBits = ~secondShelf->occupied[w].load();
+
+			while (freeBits != 0)
 			{
-				currentDrinker->opener = second;
-				second->lockCount++;
-				return true;
+				int second = (w * 64) + CountTrailingZeros(freeBits);
+				freeBits &= freeBits - 1;
+
+				if (secondShelf->locks[second].try_lock() == true)
+				{
+					secondShelf->lockCounts[second]++;
+					RECORD_LOCK_EVENT(currentDrinker, LockEventType::Acquired, secondShelf, second);
+					MarkOccupied(secondShelf, second);
+					*secondHeld = second;
+					return true;
+				}
 			}
 		}
-		else
+	}
+
+	MarkFree(firstShelf, trying);
+	RECORD_LOCK_EVENT(currentDrinker, LockEventType::Released, firstShelf, trying);
+	firstShelf->locks[trying].unlock(); 
+	*firstHeld = -1;
+	currentDrinker->wantedShelf = secondShelf;
+	WakeWaiter(pool, firstShelf);
+
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Attempts to perform a drink.
+//
+// Arguments:
+//   currentDrinker - The current drinker
+//
+// Return:
+//   True if the drinker was successfully able to drink.
+///////////////////////////////////////////////////////////////////////////////////
+bool TryToDrink(Drinker *currentDrinker)
+{
+	bool wasAbleToDrink = false;
+	StartWaiting(currentDrinker, MicrosecondsNow());
+	if (TryToGetResources(currentDrinker) != 0)
+	{
+		StopWaiting(currentDrinker, MicrosecondsNow());
+		Drink(currentDrinker);
+		wasAbleToDrink = true;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////
+	//   We're done using at least one resource when we reach this point. Nobody needs
+	//   waking here: ReleaseResources woke a waiter as soon as the resources were
+	//   freed, before the drinker's pause. In Scan mode that is one drinker per type,
+	//   in Pair and Sharded modes one drinker per pair, and in Broker and Aging modes
+	//   the broker, which wakes the drinker it hands a pair to.
+	///////////////////////////////////////////////////////////////////////////////////
+
+	return wasAbleToDrink;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Begins the primary drinking game logic. The specified drinker will constantly
+//   attempt to drink until the stopDrinkingFlag has been set. 
+//
+// Arguments:
+//   currentDrinker - The current drinker
+///////////////////////////////////////////////////////////////////////////////////
+void StartDrinker(Drinker *currentDrinker)
+{
+	printf("Drinker %d, starting\n", currentDrinker->id);
+
+	while(true)
+	{
+		////////////////////////////////////////////////////////////////////////////////////
+		// Make all access to the stopDrinkingFlag thread safe.
+		////////////////////////////////////////////////////////////////////////////////////
+		currentDrinker->drinkerPool->startingGunMutex.lock();
+
+		if (currentDrinker->drinkerPool->stopDrinkingFlag)
+		{
+			break;
+		}
+		currentDrinker->drinkerPool->startingGunMutex.unlock();
+		////////////////////////////////////////////////////////////////////////////////////
+
+		if (!TryToDrink(currentDrinker))
 		{
-			if (second->type == ResourceType::Bottle && second->resourceMutex.try_lock() == true)
+			///////////////////////////////////////////////////////////////////////////////////
+			// Make the access to the stopDrinkingFlag thread safe.
+			///////////////////////////////////////////////////////////////////////////////////
+			currentDrinker->drinkerPool->startingGunMutex.lock();
+			if(currentDrinker->drinkerPool->stopDrinkingFlag)
 			{
-				currentDrinker->bottle = second;
-				second->lockCount++;
-				return true;
+				break;
+			}
+
+			else
+			{	
+			
+				///////////////////////////////////////////////////////////////////////////////////
+				// Wait for a resource to become available using the resource pool
+				///////////////////////////////////////////////////////////////////////////////////
+				std::unique_lock<std::mutex> IamWaiting(currentDrinker->resourcePool->poolMutex);
+				currentDrinker->drinkerPool->startingGunMutex.unlock();
+
+				if (currentDrinker->resourcePool->acquireMode == AcquireMode::Scan)
+				{
+					// Only a release of the type we couldn't get is worth waking for
+					ResourceShelf *wanted = currentDrinker->wantedShelf;
+					wanted->waiterCount++;
+					if (FindFreeResource(wanted, 0, 0) == -1)
+					{
+						wanted->waitCondition.wait(IamWaiting);
+					}
+					wanted->waiterCount--;
+				}
+				else if (IsPairFree(currentDrinker->resourcePool) == false)
+				{
+					currentDrinker->resourcePool->poolCondition.wait(IamWaiting);
+				}
+				IamWaiting.unlock();
+
 			}
+			
 		}
 	}
-
-	firstResource->resourceMutex.unlock(); 
-
-	return false;
+	currentDrinker->drinkerPool->startingGunMutex.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Entry point for drinker threads.
+//
+// Arguments:
+//   currentDrinker - Pointer to a Drinker struct that is unique to this thread
+///////////////////////////////////////////////////////////////////////////////////
+void DrinkerThreadEntrypoint(Drinker *currentDrinker)
+{
+	int totalResources = currentDrinker->resourcePool->totalResources;
+	DrinkerPool *drinkerPool = currentDrinker->drinkerPool;
+
+	// A pinned drinker runs on the CPU of its home shard
+	if (currentDrinker->resourcePool->pinnedCpus > 0 && PinToCpu(currentDrinker->homeShard) == false)
+	{
+		fprintf(stderr, "Error: Drinker %d could not be pinned to CPU %d\n", currentDrinker->id, currentDrinker->homeShard);
+	}
+
+	printf("Drinker %d, is ready to start\n", currentDrinker->id);
+	
+	////////////////////////////////////////////////////////////////////////////////////////////////
+	//   Let main know there's one more drinker thread running then wait for a notification
+	//   from main via the DrinkerPool struct.
+	////////////////////////////////////////////////////////////////////////////////////////////////
+
+	drinkerPool->drinkerCountMutex.lock();
+
+	(drinkerPool->drinkerCount)++;
+	drinkerPool->drinkerCountCondition.notify_one();
+
+	std::unique_lock<std::mutex> locked(drinkerPool->startingGunMutex);
+	drinkerPool->drinkerCountMutex.unlock();
+	drinkerPool->startingGunCondition.wait(locked, [drinkerPool](){return *drinkerPool->isGunOpen == true; });
+
+	locked.unlock();
+	StartDrinker(currentDrinker);
+
+	///////////////////////////////////////////////////////////////////////////////////
+	// Let main know there's one less drinker thread running. 
+	///////////////////////////////////////////////////////////////////////////////////
+
+	drinkerPool->drinkerCountMutex.lock();
+
+	(drinkerPool->drinkerCount)--;
+	drinkerPool->drinkerCountCondition.notify_one();
+
+	drinkerPool->drinkerCountMutex.unlock();
+
+	return;
+}
+
+#if ENABLE_LOCK_GRAPH
+///////////////////////////////////////////////////////////////////////////////////
+// The lock graph built by the checker thread from the drinkers' lock event rings.
+//   Only the checker touches it, apart from the stop flag.
+///////////////////////////////////////////////////////////////////////////////////
+struct LockGraph
+{
+	// Number of resources. IDs below bottleCount are bottles.
+	int totalResources;
+	// Number of bottles.
+	int bottleCount;
+	// Per resource, by id, the drinker holding it or -1.
+	int *owner;
+	// Per resource, by id, the lock count when its owner locked it.
+	int *ownerGeneration;
+	// Per drinker, the resource id the drinker is waiting for or -1.
+	int *waitingFor;
+	// Per drinker, bottles and openers currently held.
+	int *heldBottles;
+	int *heldOpeners;
+	// Per drinker, number of checks in a row with no new events from the drinker.
+	int *quietChecks;
+	// Per drinker, set once the drinker has been reported in a deadlock. Cleared 
+	//   when it does something again.
+	bool *reported;
+	// Number of deadlocks reported.
+	int deadlockCount;
+	// Number of times an opener was locked while holding a bottle.
+	int bottleThenOpener;
+	// Number of times a bottle was locked while holding an opener.
+	int openerThenBottle;
+	// The mutex used to control access to the stopFlag.
+	std::mutex stopMutex;
+	// The condition variable used to wake the checker when the stopFlag is set.
+	std::condition_variable stopCondition;
+	// Flag to break the checker out of its loop.
+	bool stopFlag;
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+// Applies one lock event to the graph.
+//
+// Arguments:
+//   graph - The lock graph
+//   drinkerId - The drinker the event came from
+//   lockEvent - The event
+///////////////////////////////////////////////////////////////////////////////////
+void ApplyLockEvent(LockGraph *graph, int drinkerId, const LockEvent &lockEvent)
+{
+	int id = lockEvent.resourceId;
+	bool isBottle = id < graph->bottleCount;
+
+	switch (lockEvent.type)
+	{
+	case LockEventType::Waiting:
+		graph->waitingFor[drinkerId] = id;
+		break;
+	case LockEventType::GaveUp:
+		graph->waitingFor[drinkerId] = -1;
+		break;
+	case LockEventType::Acquired:
+		graph->waitingFor[drinkerId] = -1;
+		if (isBottle && graph->heldOpeners[drinkerId] > 0)
+		{
+			graph->openerThenBottle++;
+		}
+		else if (!isBottle && graph->heldBottles[drinkerId] > 0)
+		{
+			graph->bottleThenOpener++;
+		}
+		(isBottle ? graph->heldBottles : graph->heldOpeners)[drinkerId]++;
+
+		// Rings are read one after another, so the previous owner's Released may 
+		//   come later. The lock count tells which owner is newer.
+		if (lockEvent.generation > graph->ownerGeneration[id])
+		{
+			graph->owner[id] = drinkerId;
+			graph->ownerGeneration[id] = lockEvent.generation;
+		}
+		break;
+	case LockEventType::Released:
+		(isBottle ? graph->heldBottles : graph->heldOpeners)[drinkerId]--;
+		if (lockEvent.generation == graph->ownerGeneration[id])
+		{
+			graph->owner[id] = -1;
+		}
+		break;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Reports every new cycle of drinkers waiting for each other's resources. A 
+//   drinker only counts once it has been quiet for two checks, so an event still
+//   sitting in a ring can't make up a cycle that has already gone.
+//
+// Arguments:
+//   graph - The lock graph
+//   totalDrinkers - Number of drinkers
+///////////////////////////////////////////////////////////////////////////////////
+void FindDeadlocks(LockGraph *graph, int totalDrinkers)
+{
+	for (int start = 0; start < totalDrinkers; start++)
+	{
+		if (graph->reported[start] || graph->waitingFor[start] == -1 || graph->quietChecks[start] < 2)
+		{
+			continue;
+		}
+
+		// Each drinker waits for at most one resource, so there is one path to follow
+		int current = start;
+		for (int steps = 0; steps < totalDrinkers; steps++)
+		{
+			int next = graph->owner[graph->waitingFor[current]];
+			if (next == -1 || graph->waitingFor[next] == -1 || graph->quietChecks[next] < 2)
+			{
+				break;
+			}
+
+			if (next == start)
+			{
+				graph->deadlockCount++;
+				printf("Lock graph: deadlock:");
+				current = start;
+				do
+				{
+					next = graph->owner[graph->waitingFor[current]];
+					printf(" drinker %d waits for resource %d held by drinker %d;", current, graph->waitingFor[current], next);
+					graph->reported[current] = true;
+					current = next;
+				} while (current != start);
+				printf("\n");
+				break;
+			}
+
+			current = next;
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Entry point for the lock graph checker thread. Drains the lock event rings and 
+//   looks for deadlocks every 10ms until the stopFlag has been set.
+//
+// Arguments:
+//   graph - The lock graph
+//   poolOfDrinkers - The pool of drinkers
+///////////////////////////////////////////////////////////////////////////////////
+void LockGraphThreadEntrypoint(LockGraph *graph, DrinkerPool *poolOfDrinkers)
+{
+	std::unique_lock<std::mutex> stopLock(graph->stopMutex);
+
+	while (true)
+	{
+		bool stopped = graph->stopFlag;
+		stopLock.unlock();
+
+		for (int i = 0; i < poolOfDrinkers->totalDrinkers; i++)
+		{
+			LockEventRing *ring = &poolOfDrinkers->drinkers[i].lockEvents;
+			unsigned head = ring->head.load(std::memory_order_acquire);
+			unsigned tail = ring->tail.load(std::memory_order_relaxed);
+
+			if (head == tail)
+			{
+				graph->quietChecks[i]++;
+				continue;
+			}
+
+			for (; tail != head; tail++)
+			{
+				ApplyLockEvent(graph, i, ring->events[tail % LockEventRing::Size]);
+			}
+			ring->tail.store(tail, std::memory_order_release);
+			graph->quietChecks[i] = 0;
+			graph->reported[i] = false;
+		}
+
+		FindDeadlocks(graph, poolOfDrinkers->totalDrinkers);
+
+		stopLock.lock();
+		if (stopped)
+		{
+			break;
+		}
+		graph->stopCondition.wait_for(stopLock, std::chrono::milliseconds(10), [graph](){return graph->stopFlag; });
+	}
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////
+// How long a timed run or its warm-up lasts. Exactly one of the two is non-zero,
+//   unless the length is empty.
+///////////////////////////////////////////////////////////////////////////////////
+struct RunLength
+{
+	// Number of drinks to run for.
+	long long drinks;
+	// Number of seconds to run for.
+	double seconds;
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+// The counters of every drinker and resource at one point in a run. The results
+//   of a measurement window are the difference of two snapshots.
+///////////////////////////////////////////////////////////////////////////////////
+struct RunSnapshot
+{
+	// Seconds since the run started, on the clock the run uses.
+	double seconds;
+	// Per drinker, by id, drinks taken.
+	std::vector<int> drinkCounts;
+	// Per drinker, by id, resource tries.
+	std::vector<int> tryCounts;
+	// Per drinker, by id, pairs claimed from outside the home shard.
+	std::vector<int> stealCounts;
+	// Per drinker, by id, the counts of its wait histogram, BucketCount each.
+	std::vector<int> waitCounts;
+	// Per resource, by id, times locked.
+	std::vector<int> lockCounts;
+	// Per resource, by id, times used.
+	std::vector<int> useCounts;
+	// Per resource, by id, milliseconds drunk from.
+	std::vector<long long> busyTimes;
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+// Adds up the drinks of every drinker.
+//
+// Arguments:
+//   poolOfDrinkers - The pool of drinkers
+//
+// Return:
+//   The total number of drinks so far
+///////////////////////////////////////////////////////////////////////////////////
+long long TotalDrinks(const DrinkerPool &poolOfDrinkers)
+{
+	long long drinks = 0;
+	for (int i = 0; i < poolOfDrinkers.totalDrinkers; i++)
+	{
+		drinks += poolOfDrinkers.drinkers[i].drinkCount.load();
+	}
+	return drinks;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Copies the counters of every drinker and resource.
+//
+// Arguments:
+//   poolOfDrinkers - The pool of drinkers
+//   poolOfResources - The pool of resources
+//   seconds - Seconds since the run started
+//   snapshot - Filled in with the counters
+///////////////////////////////////////////////////////////////////////////////////
+void TakeSnapshot(const DrinkerPool &poolOfDrinkers, const ResourcePool &poolOfResources, double seconds, RunSnapshot *snapshot)
+{
+	const ResourceShelf *shelves[] = { &poolOfResources.bottles, &poolOfResources.openers };
+
+	snapshot->seconds = seconds;
+	snapshot->drinkCounts.clear();
+	snapshot->tryCounts.clear();
+	snapshot->stealCounts.clear();
+	snapshot->waitCounts.clear();
+	snapshot->lockCounts.clear();
+	snapshot->useCounts.clear();
+	snapshot->busyTimes.clear();
+
+	for (int i = 0; i < poolOfDrinkers.totalDrinkers; i++)
+	{
+		snapshot->drinkCounts.push_back(poolOfDrinkers.drinkers[i].drinkCount.load());
+		snapshot->tryCounts.push_back(poolOfDrinkers.drinkers[i].resourceTryCount.load());
+		snapshot->stealCounts.push_back(poolOfDrinkers.drinkers[i].stealCount.load());
+
+		for (int b = 0; b < WaitHistogram::BucketCount; b++)
+		{
+			snapshot->waitCounts.push_back(poolOfDrinkers.drinkers[i].waits.counts[b].load());
+		}
+	}
+
+	for (const ResourceShelf *shelf : shelves)
+	{
+		for (int i = 0; i < shelf->count; i++)
+		{
+			snapshot->lockCounts.push_back(shelf->lockCounts[i].load());
+			snapshot->useCounts.push_back(shelf->useCounts[i].load());
+			snapshot->busyTimes.push_back(shelf->busyTimes[i].load());
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Finds how long a fraction of the waits in a histogram were shorter than.
+//
+// Arguments:
+//   counts - Number of waits in each bucket
+//   fraction - Fraction of the waits, 1 for the longest wait
+//
+// Return:
+//   Milliseconds the waits were shorter than, 0 if there were no waits
+///////////////////////////////////////////////////////////////////////////////////
+double WaitPercentile(const std::vector<long long> &counts, double fraction)
+{
+	long long total = 0;
+	for (long long count : counts)
+	{
+		total += count;
+	}
+
+	long long wanted = (long long)(fraction * total + 0.5);
+	long long seen = 0;
+	for (int b = 0; b < (int)counts.size(); b++)
+	{
+		seen += counts[b];
+		if (counts[b] > 0 && seen >= wanted)
+		{
+			return WaitBucketLimit(b) / 1000.0;
+		}
+	}
+	return 0.0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Prints the results of a measurement window and writes them as JSON, so runs of
+//   different builds can be compared by a script.
+//
+// Arguments:
+//   poolOfResources - The pool of resources
+//   start - Snapshot at the start of the window
+//   end - Snapshot at the end of the window
+//   settings - JSON members describing the run, written first
+//   fileName - File to write the JSON to
+///////////////////////////////////////////////////////////////////////////////////
+void ReportWindow(const ResourcePool &poolOfResources, const RunSnapshot &start, const RunSnapshot &end, const char *settings, const char *fileName)
+{
+	double seconds = end.seconds - start.seconds;
+	long long drinks = 0;
+	long long tries = 0;
+	long long steals = 0;
+	double sumOfSquares = 0.0;
+	int minDrinks = INT_MAX;
+	int maxDrinks = 0;
+	int drinkerCount = (int)end.drinkCounts.size();
+
+	for (int i = 0; i < drinkerCount; i++)
+	{
+		int drank = end.drinkCounts[i] - start.drinkCounts[i];
+		drinks += drank;
+		tries += end.tryCounts[i] - start.tryCounts[i];
+		steals += end.stealCounts[i] - start.stealCounts[i];
+		sumOfSquares += (double)drank * drank;
+		minDrinks = (drank < minDrinks) ? drank : minDrinks;
+		maxDrinks = (drank > maxDrinks) ? drank : maxDrinks;
+	}
+
+	// Wait histograms of the window, all drinkers together and each drinker's longest
+	std::vector<long long> allWaits(WaitHistogram::BucketCount, 0);
+	std::vector<double> longestWaits(drinkerCount, 0.0);
+	int longestWaiter = -1;
+
+	for (int i = 0; i < drinkerCount; i++)
+	{
+		std::vector<long long> waits(WaitHistogram::BucketCount);
+		for (int b = 0; b < WaitHistogram::BucketCount; b++)
+		{
+			int at = i * WaitHistogram::BucketCount + b;
+			waits[b] = end.waitCounts[at] - start.waitCounts[at];
+			allWaits[b] += waits[b];
+		}
+
+		longestWaits[i] = WaitPercentile(waits, 1.0);
+		if (longestWaiter == -1 || longestWaits[i] > longestWaits[longestWaiter])
+		{
+			longestWaiter = i;
+		}
+	}
+
+	double waitP50 = WaitPercentile(allWaits, 0.5);
+	double waitP99 = WaitPercentile(allWaits, 0.99);
+	double longestWait = (longestWaiter != -1) ? longestWaits[longestWaiter] : 0.0;
+
+	// Jain's fairness index: 1 when every drinker drank the same, 1/n when one drank it all
+	double fairness = (sumOfSquares > 0.0) ? ((double)drinks * drinks) / (drinkerCount * sumOfSquares) : 1.0;
+	double drinksPerSecond = (seconds > 0.0) ? drinks / seconds : 0.0;
+	double triesPerDrink = (drinks > 0) ? (double)tries / drinks : 0.0;
+
+	printf("*********Measurement window**********\n");
+	printf("%.2f seconds, %lld drinks, %lld tries\n", seconds, drinks, tries);
+	printf("%.1f drinks per second, %.2f tries per drink\n", drinksPerSecond, triesPerDrink);
+	printf("Fairness %.3f, drinks per drinker %d to %d\n", fairness, (drinkerCount > 0) ? minDrinks : 0, maxDrinks);
+	printf("Waits p50 under %.2f ms, p99 under %.2f ms, longest under %.2f ms (drinker %d)\n", waitP50, waitP99, longestWait, longestWaiter);
+	if (poolOfResources.acquireMode == AcquireMode::Sharded)
+	{
+		printf("%d shards, %lld pairs stolen from another shard (%.1f%% of drinks)\n", poolOfResources.shardCount, steals, (drinks > 0) ? 100.0 * steals / drinks : 0.0);
+	}
+	printf("\n");
+
+	FILE *file = fopen(fileName, "w");
+	if (file == nullptr)
+	{
+		fprintf(stderr, "Error: Could not write %s\n", fileName);
+		return;
+	}
+
+	fprintf(file, "{\n  %s,\n", settings);
+	fprintf(file, "  \"seconds\": %.3f,\n  \"drinks\": %lld,\n  \"tries\": %lld,\n", seconds, drinks, tries);
+	fprintf(file, "  \"drinksPerSecond\": %.3f,\n  \"triesPerDrink\": %.4f,\n", drinksPerSecond, triesPerDrink);
+	fprintf(file, "  \"fairness\": %.4f,\n  \"minDrinks\": %d,\n  \"maxDrinks\": %d,\n", fairness, (drinkerCount > 0) ? minDrinks : 0, maxDrinks);
+	fprintf(file, "  \"shards\": %d,\n  \"steals\": %lld,\n", poolOfResources.shardCount, steals);
+	fprintf(file, "  \"waitP50Ms\": %.3f,\n  \"waitP99Ms\": %.3f,\n  \"maxWaitMs\": %.3f,\n", waitP50, waitP99, longestWait);
+
+	// Each drinker's waits are written as [ms the bucket's waits were shorter than, count] 
+	//   for every bucket that has any
+	fprintf(file, "  \"drinkers\": [");
+	for (int i = 0; i < drinkerCount; i++)
+	{
+		fprintf(file, "%s\n    {\"id\": %d, \"drinks\": %d, \"tries\": %d, \"steals\": %d, \"maxWaitMs\": %.3f, \"waits\": [", (i > 0) ? "," : "", i,
+			end.drinkCounts[i] - start.drinkCounts[i], end.tryCounts[i] - start.tryCounts[i], end.stealCounts[i] - start.stealCounts[i], longestWaits[i]);
+
+		bool first = true;
+		for (int b = 0; b < WaitHistogram::BucketCount; b++)
+		{
+			int at = i * WaitHistogram::BucketCount + b;
+			int count = end.waitCounts[at] - start.waitCounts[at];
+			if (count > 0)
+			{
+				fprintf(file, "%s[%.3f, %d]", first ? "" : ", ", WaitBucketLimit(b) / 1000.0, count);
+				first = false;
+			}
+		}
+		fprintf(file, "]}");
+	}
+	fprintf(file, "\n  ],\n");
+
+	fprintf(file, "  \"resources\": [");
+	for (int i = 0; i < (int)end.useCounts.size(); i++)
+	{
+		double busySeconds = (end.busyTimes[i] - start.busyTimes[i]) / 1000.0;
+		fprintf(file, "%s\n    {\"id\": %d, \"type\": \"%s\", \"locks\": %d, \"uses\": %d, \"utilisation\": %.4f}", (i > 0) ? "," : "", i,
+			(i < poolOfResources.bottles.count) ? "bottle" : "opener",
+			end.lockCounts[i] - start.lockCounts[i], end.useCounts[i] - start.useCounts[i],
+			(seconds > 0.0) ? busySeconds / seconds : 0.0);
+	}
+	fprintf(file, "\n  ]\n}\n");
+	fclose(file);
+
+	printf("Results written to %s\n\n", fileName);
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// The things that can happen to a drinker in virtual time.
+///////////////////////////////////////////////////////////////////////////////////
+enum class SimEventType
+{
+	// The drinker tries to get a bottle and an opener.
+	Attempt,
+	// The drinker was handed a resource mutex it was blocked on. Scan and Block modes.
+	Locked,
+	// The drinker is done drinking.
+	DrinkDone
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+// One scheduled event. The sequence breaks ties so equal times run in the order 
+//   they were scheduled.
+///////////////////////////////////////////////////////////////////////////////////
+struct SimEvent
+{
+	// Virtual time of the event in milliseconds.
+	long long time;
+	// Order the event was scheduled in.
+	long long sequence;
+	// What happens.
+	SimEventType type;
+	// ID of the drinker it happens to.
+	int drinker;
+	// For Locked, the ID of the resource handed over.
+	int resourceId;
+
+	bool operator>(const SimEvent &other) const
+	{
+		return (time != other.time) ? (time > other.time) : (sequence > other.sequence);
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+// Runs the drinking game in virtual time. Instead of a thread per drinker sleeping
+//   through every drink, the drinkers are driven from one priority queue of events
+//   and a blocked drinker is just an entry in a queue. It uses the same shelves, 
+//   counters and acquire modes as the threaded game, so the results are comparable.
+///////////////////////////////////////////////////////////////////////////////////
+struct Simulation
+{
+	// The pool of drinkers.
+	DrinkerPool *drinkerPool;
+	// The pool of resources.
+	ResourcePool *resourcePool;
+	// Current virtual time in milliseconds.
+	long long now;
+	// Sequence number for the next event.
+	long long nextSequence;
+	// Number of events processed.
+	long long eventCount;
+	// Number of drinks taken so far.
+	long long drinkCount;
+	// Events that have not happened yet, soonest first.
+	std::priority_queue<SimEvent, std::vector<SimEvent>, std::greater<SimEvent> > events;
+	// Per resource, by id, the drinkers blocked on its mutex, oldest first.
+	std::vector<std::deque<int> > lockQueues;
+	// Drinkers waiting for a bottle or an opener to be released, by shelf. Scan mode.
+	std::deque<int> bottleWaiters;
+	std::deque<int> openerWaiters;
+	// Drinkers waiting for a pair. Pair and Sharded modes, the broker modes use the
+	//   pool's queue.
+	std::deque<int> pairWaiters;
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+// Puts an event on the queue.
+//
+// Arguments:
+//   sim - The simulation
+//   delay - Milliseconds from now
+//   type - What happens
+//   drinker - ID of the drinker it happens to
+//   resourceId - For Locked, the resource handed over
+///////////////////////////////////////////////////////////////////////////////////
+void SimSchedule(Simulation *sim, long long delay, SimEventType type, int drinker, int resourceId)
+{
+	SimEvent simEvent;
+	simEvent.time = sim->now + delay;
+	simEvent.sequence = sim->nextSequence++;
+	simEvent.type = type;
+	simEvent.drinker = drinker;
+	simEvent.resourceId = resourceId;
+	sim->events.push(simEvent);
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Gets the shelf and shelf index of a resource id.
+//
+// Arguments:
+//   pool - The pool of resources
+//   resourceId - ID of the resource
+//   index - Set to the index on the shelf
+//
+// Return:
+//   The shelf holding the resource
+///////////////////////////////////////////////////////////////////////////////////
+ResourceShelf *SimFindShelf(ResourcePool *pool, int resourceId, int *index)
+{
+	if (resourceId < pool->bottles.count)
+	{
+		*index = resourceId;
+		return &pool->bottles;
+	}
+
+	*index = resourceId - pool->bottles.count;
+	return &pool->openers;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Unlocks a resource mutex in Scan and Block modes. The next drinker blocked on it 
+//   gets it, otherwise it is free and one drinker waiting for its type is woken.
+//
+// Arguments:
+//   sim - The simulation
+//   shelf - The shelf holding the resource
+//   index - Index of the resource on the shelf
+///////////////////////////////////////////////////////////////////////////////////
+void SimUnlock(Simulation *sim, ResourceShelf *shelf, int index)
+{
+	std::deque<int> &blocked = sim->lockQueues[shelf->ids[index]];
+
+	if (blocked.empty() == false)
+	{
+		int next = blocked.front();
+		blocked.pop_front();
+		SimSchedule(sim, 0, SimEventType::Locked, next, shelf->ids[index]);
+		return;
+	}
+
+	MarkFree(shelf, index);
+
+	std::deque<int> &waiters = (shelf->type == ResourceType::Bottle) ? sim->bottleWaiters : sim->openerWaiters;
+	if (waiters.empty() == false)
+	{
+		SimSchedule(sim, 0, SimEventType::Attempt, waiters.front(), -1);
+		waiters.pop_front();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Starts a drink with the bottle and opener the drinker holds.
+//
+// Arguments:
+//   sim - The simulation
+//   currentDrinker - The current drinker
+///////////////////////////////////////////////////////////////////////////////////
+void SimStartDrink(Simulation *sim, Drinker *currentDrinker)
+{
+	int drinkTime = 20 + currentDrinker->myRand.Bounded(20);
+
+	StopWaiting(currentDrinker, sim->now * 1000);
+	sim->resourcePool->bottles.useCounts[currentDrinker->bottle]++;
+	sim->resourcePool->openers.useCounts[currentDrinker->opener]++;
+	sim->resourcePool->bottles.busyTimes[currentDrinker->bottle] += drinkTime;
+	sim->resourcePool->openers.busyTimes[currentDrinker->opener] += drinkTime;
+	SimSchedule(sim, drinkTime, SimEventType::DrinkDone, currentDrinker->id, -1);
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Hands free bottle and opener pairs to the drinkers the broker serves first, who
+//   start drinking right away. Broker and Aging modes.
+//
+// Arguments:
+//   sim - The simulation
+///////////////////////////////////////////////////////////////////////////////////
+void SimRunBroker(Simulation *sim)
+{
+	ResourcePool *pool = sim->resourcePool;
+
+	while (pool->waitingCount > 0 && pool->bottles.freeHead.load() != -1 && pool->openers.freeHead.load() != -1)
+	{
+		Drinker *nextDrinker = NextForBroker(pool, sim->drinkerPool->totalDrinkers);
+
+		nextDrinker->bottle = PopFree(&pool->bottles);
+		nextDrinker->opener = PopFree(&pool->openers);
+		pool->bottles.lockCounts[nextDrinker->bottle]++;
+		pool->openers.lockCounts[nextDrinker->opener]++;
+		SimStartDrink(sim, nextDrinker);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// The drinker holds a resource mutex in Scan or Block mode. With one resource it 
+//   goes for the other type the same way TryToGetResources does, with both it 
+//   drinks.
+//
+// Arguments:
+//   sim - The simulation
+//   currentDrinker - The current drinker
+//   shelf - The shelf holding the resource just locked
+//   index - Index of the resource on the shelf
+///////////////////////////////////////////////////////////////////////////////////
+void SimLocked(Simulation *sim, Drinker *currentDrinker, ResourceShelf *shelf, int index)
+{
+	ResourcePool *pool = sim->resourcePool;
+	bool isBottle = shelf->type == ResourceType::Bottle;
+	ResourceShelf *other = isBottle ? &pool->openers : &pool->bottles;
+	int otherHeld = isBottle ? currentDrinker->opener : currentDrinker->bottle;
+
+	shelf->lockCounts[index]++;
+	(isBottle ? currentDrinker->bottle : currentDrinker->opener) = index;
+
+	if (otherHeld != -1)
+	{
+		SimStartDrink(sim, currentDrinker);
+		return;
+	}
+
+	if (pool->acquireMode == AcquireMode::Block)
+	{
+		if (other->count > 0)
+		{
+			int second = currentDrinker->myRand.Bounded(other->count);
+			if (MarkOccupied(other, second))
+			{
+				SimLocked(sim, currentDrinker, other, second);
+			}
+			else
+			{
+				sim->lockQueues[other->ids[second]].push_back(currentDrinker->id);
+			}
+		}
+		return;
+	}
+
+	int second = FindFreeResource(other, 0, 0);
+	if (second != -1)
+	{
+		MarkOccupied(other, second);
+		SimLocked(sim, currentDrinker, other, second);
+		return;
+	}
+
+	// Give the first one back and wait for a release of the type we couldn't get
+	(isBottle ? currentDrinker->bottle : currentDrinker->opener) = -1;
+	SimUnlock(sim, shelf, index);
+
+	if (FindFreeResource(other, 0, 0) != -1)
+	{
+		SimSchedule(sim, 0, SimEventType::Attempt, currentDrinker->id, -1);
+	}
+	else
+	{
+		(isBottle ? sim->openerWaiters : sim->bottleWaiters).push_back(currentDrinker->id);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// The drinker tries to get a bottle and an opener.
+//
+// Arguments:
+//   sim - The simulation
+//   currentDrinker - The current drinker
+///////////////////////////////////////////////////////////////////////////////////
+void SimAttempt(Simulation *sim, Drinker *currentDrinker)
+{
+	ResourcePool *pool = sim->resourcePool;
+
+	StartWaiting(currentDrinker, sim->now * 1000);
+
+	if (pool->acquireMode == AcquireMode::Pair || pool->acquireMode == AcquireMode::Sharded)
+	{
+		if (TryToGetPair(currentDrinker))
+		{
+			SimStartDrink(sim, currentDrinker);
+		}
+		else
+		{
+			sim->pairWaiters.push_back(currentDrinker->id);
+		}
+		return;
+	}
+
+	if (pool->acquireMode == AcquireMode::Broker || pool->acquireMode == AcquireMode::Aging)
+	{
+		currentDrinker->resourceTryCount++;
+		QueueForBroker(pool, currentDrinker, sim->drinkerPool->totalDrinkers);
+		SimRunBroker(sim);
+		return;
+	}
+
+	currentDrinker->resourceTryCount++;
+
+	int index;
+	ResourceShelf *shelf = SimFindShelf(pool, currentDrinker->myRand.Bounded(pool->totalResources), &index);
+
+	if (MarkOccupied(shelf, index))
+	{
+		SimLocked(sim, currentDrinker, shelf, index);
+	}
+	else
+	{
+		sim->lockQueues[shelf->ids[index]].push_back(currentDrinker->id);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// The drinker is done drinking. Gives back the bottle and opener and schedules the
+//   next attempt after the same pauses as Drink.
+//
+// Arguments:
+//   sim - The simulation
+//   currentDrinker - The current drinker
+///////////////////////////////////////////////////////////////////////////////////
+void SimDrinkDone(Simulation *sim, Drinker *currentDrinker)
+{
+	ResourcePool *pool = sim->resourcePool;
+	int drunkTime = 40 + currentDrinker->myRand.Bounded(10);
+	int bathroomTime = 60 + currentDrinker->myRand.Bounded(10);
+	int bottle = currentDrinker->bottle;
+	int opener = currentDrinker->opener;
+
+	currentDrinker->bottle = -1;
+	currentDrinker->opener = -1;
+	currentDrinker->drinkCount++;
+	sim->drinkCount++;
+
+	if (pool->acquireMode == AcquireMode::Pair || pool->acquireMode == AcquireMode::Sharded)
+	{
+		MarkFree(&pool->bottles, bottle);
+		MarkFree(&pool->openers, opener);
+		if (sim->pairWaiters.empty() == false)
+		{
+			SimSchedule(sim, 0, SimEventType::Attempt, sim->pairWaiters.front(), -1);
+			sim->pairWaiters.pop_front();
+		}
+	}
+	else if (pool->acquireMode == AcquireMode::Broker || pool->acquireMode == AcquireMode::Aging)
+	{
+		PushFree(&pool->bottles, bottle);
+		PushFree(&pool->openers, opener);
+		SimRunBroker(sim);
+	}
+	else
+	{
+		SimUnlock(sim, &pool->bottles, bottle);
+		SimUnlock(sim, &pool->openers, opener);
+	}
+
+	if ((currentDrinker->drinkCount % 5) == 0)
+	{
+		SimSchedule(sim, drunkTime, SimEventType::Attempt, currentDrinker->id, -1);
+	}
+	else if ((currentDrinker->drinkCount % 10) == 0)
+	{
+		SimSchedule(sim, bathroomTime, SimEventType::Attempt, currentDrinker->id, -1);
+	}
+	else
+	{
+		SimSchedule(sim, 0, SimEventType::Attempt, currentDrinker->id, -1);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Sets up a simulation with every drinker about to make its first attempt.
+//
+// Arguments:
+//   sim - The simulation
+//   poolOfDrinkers - The pool of drinkers
+//   poolOfResources - The pool of resources
+///////////////////////////////////////////////////////////////////////////////////
+void InitSimulation(Simulation *sim, DrinkerPool *poolOfDrinkers, ResourcePool *poolOfResources)
+{
+	sim->drinkerPool = poolOfDrinkers;
+	sim->resourcePool = poolOfResources;
+	sim->now = 0;
+	sim->nextSequence = 0;
+	sim->eventCount = 0;
+	sim->drinkCount = 0;
+	sim->lockQueues.resize(poolOfResources->totalResources);
+
+	for (int i = 0; i < poolOfDrinkers->totalDrinkers; i++)
+	{
+		SimSchedule(sim, 0, SimEventType::Attempt, i, -1);
+	}
 }
 
 ///////////////////////////////////////////////////////////////////////////////////
-// Attempts to perform a drink.
+// Checks whether a drinker is blocked on a mutex that another blocked drinker 
+//   holds. Only meaningful once nothing is left to happen, when that means the
+//   drinkers are waiting on each other in a cycle.
 //
 // Arguments:
-//   currentDrinker - The current drinker
+//   sim - The simulation
 //
 // Return:
-//   True if the drinker was successfully able to drink.
+//   True if the drinkers are deadlocked
 ///////////////////////////////////////////////////////////////////////////////////
-bool TryToDrink(Drinker *currentDrinker)
+bool SimIsDeadlocked(const Simulation *sim)
 {
-	bool wasAbleToDrink = false;
-	if (TryToGetResources(currentDrinker) != 0)
+	const ResourcePool *pool = sim->resourcePool;
+	std::vector<int> holders(sim->lockQueues.size(), -1);
+	std::vector<bool> blocked(sim->drinkerPool->totalDrinkers, false);
+
+	for (int i = 0; i < sim->drinkerPool->totalDrinkers; i++)
 	{
-		Drink(currentDrinker);
-		wasAbleToDrink = true;
+		const Drinker *drinker = &sim->drinkerPool->drinkers[i];
+		if (drinker->bottle != -1)
+		{
+			holders[pool->bottles.ids[drinker->bottle]] = i;
+		}
+		if (drinker->opener != -1)
+		{
+			holders[pool->openers.ids[drinker->opener]] = i;
+		}
 	}
 
-	///////////////////////////////////////////////////////////////////////////////////
-	//   We're done using at least one resource when we reach this point. Let all
-	//   waiting threads know that we've just unlocked at least one resource so they can
-	//   try to drink again.
-	///////////////////////////////////////////////////////////////////////////////////
+	for (size_t resourceId = 0; resourceId < sim->lockQueues.size(); resourceId++)
+	{
+		for (size_t i = 0; i < sim->lockQueues[resourceId].size(); i++)
+		{
+			blocked[sim->lockQueues[resourceId][i]] = true;
+		}
+	}
 
-	currentDrinker->resourcePool->poolCondition.notify_all();
-	return wasAbleToDrink;
+	for (size_t resourceId = 0; resourceId < sim->lockQueues.size(); resourceId++)
+	{
+		if (sim->lockQueues[resourceId].empty() == false && holders[resourceId] != -1 && blocked[holders[resourceId]])
+		{
+			return true;
+		}
+	}
+	return false;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////
-// Begins the primary drinking game logic. The specified drinker will constantly
-//   attempt to drink until the stopDrinkingFlag has been set. 
+// Runs the simulation on from where it is for a number of drinks or virtual
+//   seconds, or until every drinker is blocked.
 //
 // Arguments:
-//   currentDrinker - The current drinker
+//   sim - The simulation
+//   length - How much longer to run
+//
+// Return:
+//   False if every drinker is blocked, so the simulation can't go on
 ///////////////////////////////////////////////////////////////////////////////////
-void StartDrinker(Drinker *currentDrinker)
+bool RunSimulation(Simulation *sim, const RunLength &length)
 {
-	printf("Drinker %d, starting\n", currentDrinker->id);
+	long long endDrinks = sim->drinkCount + length.drinks;
+	long long endTime = sim->now + (long long)(length.seconds * 1000.0);
 
-	while(true)
+	if (length.drinks == 0 && length.seconds <= 0.0)
 	{
-		////////////////////////////////////////////////////////////////////////////////////
-		// Make all access to the stopDrinkingFlag thread safe.
-		////////////////////////////////////////////////////////////////////////////////////
-		currentDrinker->drinkerPool->startingGunMutex.lock();
+		return sim->events.empty() == false;
+	}
 
-		if (currentDrinker->drinkerPool->stopDrinkingFlag)
+	while (sim->events.empty() == false)
+	{
+		if ((length.drinks > 0 && sim->drinkCount >= endDrinks) ||
+			(length.drinks == 0 && sim->events.top().time > endTime))
 		{
 			break;
 		}
-		currentDrinker->drinkerPool->startingGunMutex.unlock();
-		////////////////////////////////////////////////////////////////////////////////////
 
-		if (!TryToDrink(currentDrinker))
+		SimEvent simEvent = sim->events.top();
+		sim->events.pop();
+		sim->now = simEvent.time;
+		sim->eventCount++;
+
+		Drinker *currentDrinker = &sim->drinkerPool->drinkers[simEvent.drinker];
+
+		switch (simEvent.type)
 		{
-			///////////////////////////////////////////////////////////////////////////////////
-			// Make the access to the stopDrinkingFlag thread safe.
-			///////////////////////////////////////////////////////////////////////////////////
-			currentDrinker->drinkerPool->startingGunMutex.lock();
-			if(currentDrinker->drinkerPool->stopDrinkingFlag)
+		case SimEventType::Attempt:
+			SimAttempt(sim, currentDrinker);
+			break;
+		case SimEventType::Locked:
 			{
-				break;
+				int index;
+				ResourceShelf *shelf = SimFindShelf(sim->resourcePool, simEvent.resourceId, &index);
+				SimLocked(sim, currentDrinker, shelf, index);
 			}
+			break;
+		case SimEventType::DrinkDone:
+			SimDrinkDone(sim, currentDrinker);
+			break;
+		}
+	}
 
-			else
-			{	
-			
-				///////////////////////////////////////////////////////////////////////////////////
-				// Wait for a resource to become available using the resource pool
-				///////////////////////////////////////////////////////////////////////////////////
-				std::unique_lock<std::mutex> IamWaiting(currentDrinker->resourcePool->poolMutex);
-				currentDrinker->drinkerPool->startingGunMutex.unlock();
-
-				currentDrinker->resourcePool->poolCondition.wait(IamWaiting);
-				IamWaiting.unlock();
-
-			}
-			
+	if (sim->events.empty())
+	{
+		if (SimIsDeadlocked(sim))
+		{
+			printf("Simulation: every drinker is blocked after %lld drinks, the drinkers are deadlocked\n", sim->drinkCount);
+		}
+		else
+		{
+			printf("Simulation: every drinker is waiting after %lld drinks and nobody has anything left to release\n", sim->drinkCount);
 		}
+		return false;
 	}
-	currentDrinker->drinkerPool->startingGunMutex.unlock();
+
+	if (length.drinks == 0)
+	{
+		sim->now = endTime;
+	}
+	return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////
-// Entry point for drinker threads.
+// Reads a run length from the command line.
 //
 // Arguments:
-//   currentDrinker - Pointer to a Drinker struct that is unique to this thread
+//   text - A number of drinks, or a number of seconds followed by 's'
+//   length - Set to the length read
+//
+// Return:
+//   True if the text was a valid length
 ///////////////////////////////////////////////////////////////////////////////////
-void DrinkerThreadEntrypoint(Drinker *currentDrinker)
+bool ParseRunLength(const char *text, RunLength *length)
 {
-	int totalResources = currentDrinker->resourcePool->totalResources;
-	DrinkerPool *drinkerPool = currentDrinker->drinkerPool;
+	char *end;
+	double value = strtod(text, &end);
 
-	printf("Drinker %d, is ready to start\n", currentDrinker->id);
-	
-	////////////////////////////////////////////////////////////////////////////////////////////////
-	//   Let main know there's one more drinker thread running then wait for a notification
-	//   from main via the DrinkerPool struct.
-	////////////////////////////////////////////////////////////////////////////////////////////////
+	length->drinks = 0;
+	length->seconds = 0.0;
 
-	drinkerPool->drinkerCountMutex.lock();
+	if (end == text || value < 0.0)
+	{
+		return false;
+	}
 
-	(drinkerPool->drinkerCount)++;
-	drinkerPool->drinkerCountCondition.notify_one();
+	if (strcmp(end, "s") == 0)
+	{
+		length->seconds = value;
+		return true;
+	}
 
-	std::unique_lock<std::mutex> locked(drinkerPool->startingGunMutex);
-	drinkerPool->drinkerCountMutex.unlock();
-	drinkerPool->startingGunCondition.wait(locked, [drinkerPool](){return *drinkerPool->isGunOpen == true; });
+	length->drinks = (long long)value;
+	return *end == '\0' && (double)length->drinks == value;
+}
 
-	locked.unlock();
-	StartDrinker(currentDrinker);
+///////////////////////////////////////////////////////////////////////////////////
+// Writes a run length the way ParseRunLength reads it.
+//
+// Arguments:
+//   length - The length
+//
+// Return:
+//   A number of drinks, or a number of seconds followed by 's'
+///////////////////////////////////////////////////////////////////////////////////
+std::string FormatRunLength(const RunLength &length)
+{
+	// Long enough for any long long or %g double
+	char text[40];
 
-	///////////////////////////////////////////////////////////////////////////////////
-	// Let main know there's one less drinker thread running. 
-	///////////////////////////////////////////////////////////////////////////////////
+	if (length.drinks == 0 && length.seconds > 0.0)
+	{
+		sprintf(text, "%gs", length.seconds);
+	}
+	else
+	{
+		sprintf(text, "%lld", length.drinks);
+	}
+	return text;
+}
 
-	drinkerPool->drinkerCountMutex.lock();
+///////////////////////////////////////////////////////////////////////////////////
+// Waits while threaded drinkers run for a number of drinks or seconds. A run
+//   measured in drinks gives up once StalledRunSeconds pass without a drink.
+//
+// Arguments:
+//   poolOfDrinkers - The pool of drinkers
+//   length - How long to wait
+//
+// Return:
+//   False if the drinkers stalled before the run was over
+///////////////////////////////////////////////////////////////////////////////////
+bool WaitForRun(const DrinkerPool &poolOfDrinkers, const RunLength &length)
+{
+	if (length.drinks == 0)
+	{
+		std::this_thread::sleep_for(std::chrono::duration<double>(length.seconds));
+		return true;
+	}
 
-	(drinkerPool->drinkerCount)--;
-	drinkerPool->drinkerCountCondition.notify_one();
+	long long lastDrinks = TotalDrinks(poolOfDrinkers);
+	long long endDrinks = lastDrinks + length.drinks;
+	std::chrono::steady_clock::time_point lastDrink = std::chrono::steady_clock::now();
 
-	drinkerPool->drinkerCountMutex.unlock();
+	while (lastDrinks < endDrinks)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
 
-	return;
+		long long drinks = TotalDrinks(poolOfDrinkers);
+		if (drinks != lastDrinks)
+		{
+			lastDrinks = drinks;
+			lastDrink = std::chrono::steady_clock::now();
+		}
+		else if (std::chrono::steady_clock::now() - lastDrink >= std::chrono::seconds(StalledRunSeconds))
+		{
+			printf("Main: no drinks in %d seconds after %lld drinks, the drinkers are stalled\n", StalledRunSeconds, lastDrinks);
+			return false;
+		}
+	}
+	return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////
@@ -397,36 +2347,53 @@ void DrinkerThreadEntrypoint(Drinker *currentDrinker)
 // Arguments:
 //   poolOfDrinkers - The pool of drinkers
 //   resourcePool - The pool of resources.
+//   seconds - How long the drinkers were drinking
 ///////////////////////////////////////////////////////////////////////////////////
-void PrintResults(const DrinkerPool &poolOfDrinkers, const ResourcePool &poolOfResources)
+void PrintResults(const DrinkerPool &poolOfDrinkers, const ResourcePool &poolOfResources, double seconds)
 {
 	int resourceUseCount = 0;
 	int resourceLockCount = 0;
 	int drinkCount = 0;
 	int resourceTryCount = 0;
+	const ResourceShelf *shelves[] = { &poolOfResources.bottles, &poolOfResources.openers };
 
 	printf("*********Drinkers**********\n");
 	for (int i = 0; i < poolOfDrinkers.totalDrinkers; i++)
 	{
-		printf("Drinker %d, Drank %d, %d tries\n", poolOfDrinkers.drinkers[i].id, poolOfDrinkers.drinkers[i].drinkCount, poolOfDrinkers.drinkers[i].resourceTryCount); 
+		std::vector<long long> waits(WaitHistogram::BucketCount);
+		for (int b = 0; b < WaitHistogram::BucketCount; b++)
+		{
+			waits[b] = poolOfDrinkers.drinkers[i].waits.counts[b].load();
+		}
+
+		printf("Drinker %d, Drank %d, %d tries, longest wait under %.2f ms\n", poolOfDrinkers.drinkers[i].id, poolOfDrinkers.drinkers[i].drinkCount.load(), 
+			poolOfDrinkers.drinkers[i].resourceTryCount.load(), WaitPercentile(waits, 1.0)); 
 		drinkCount += poolOfDrinkers.drinkers[i].drinkCount;
 		resourceTryCount += poolOfDrinkers.drinkers[i].resourceTryCount;
 	}
 	printf("Total Drinkers %d, Drinks %d, Resource tries %d\n\n\n", poolOfDrinkers.totalDrinkers, drinkCount, resourceTryCount);
 
 	printf("*********Resource Results **********\n");
-	for (int i = 0; i < poolOfResources.totalResources; i++)
+	for (const ResourceShelf *shelf : shelves)
 	{
-		printf("Resource %d - type:%s , locked %d, used %d\n", 
-			poolOfResources.resources[i].id,
-			(poolOfResources.resources[i].type == ResourceType::Bottle) ? "bottle" : "opener",
-			poolOfResources.resources[i].lockCount,
-			poolOfResources.resources[i].useCount);
-		resourceUseCount += poolOfResources.resources[i].useCount;
-		resourceLockCount += poolOfResources.resources[i].lockCount;
+		for (int i = 0; i < shelf->count; i++)
+		{
+			printf("Resource %d - type:%s , locked %d, used %d\n", 
+				shelf->ids[i],
+				(shelf->type == ResourceType::Bottle) ? "bottle" : "opener",
+				shelf->lockCounts[i].load(),
+				shelf->useCounts[i].load());
+			resourceUseCount += shelf->useCounts[i];
+			resourceLockCount += shelf->lockCounts[i];
+		}
 	}
 
 	printf("Total Resources = %d, %d use count, %d locked count\n\n\n", poolOfResources.totalResources, resourceUseCount, resourceLockCount);
+
+	if (seconds > 0.0 && drinkCount > 0)
+	{
+		printf("%.1f drinks per second, %.2f tries per drink\n\n", drinkCount / seconds, (double)resourceTryCount / drinkCount);
+	}
 }
 
 int main(int argc, char **argv)
@@ -437,6 +2404,12 @@ int main(int argc, char **argv)
 	int bottleCount;
 	int openerCount;
 	int drinkerCount;
+	RunLength runLength = { 0, 0.0 };
+	RunLength warmup = { 0, 0.0 };
+	bool timedRun = false;
+	bool virtualClock = true;
+	int cores = 0;
+	std::string settings;
 	DrinkerPool poolOfDrinkers;
 	ResourcePool poolOfResources;
 
@@ -444,13 +2417,20 @@ int main(int argc, char **argv)
 	int readyDrinkers = 0;
 	bool gunopen = false;
 
-	if (argc != 4)
+	if (argc < 4 || argc > 9)
 	{
-		fprintf(stderr, "Usage: DrinkingGame drinkerCount bottleCount openerCount\n\n");
+		fprintf(stderr, "Usage: DrinkingGame drinkerCount bottleCount openerCount [acquire [length [warmup [clock [cores]]]]]\n\n");
 		fprintf(stderr, "Arguments:\n");
 		fprintf(stderr, "    drinkerCount                 Number of drinkers.                           \n");
 		fprintf(stderr, "    bottleCount                  Number of bottles.                            \n");
 		fprintf(stderr, "    openerCount                  Number of openers.                            \n");
+		fprintf(stderr, "    acquire                      scan (default), pair, broker, block, aging or \n");
+		fprintf(stderr, "                                 shard.                                        \n");
+		fprintf(stderr, "    length                       Drinks to measure, or seconds followed by s.  \n");
+		fprintf(stderr, "                                 Without it the run stops when Enter is pressed.\n");
+		fprintf(stderr, "    warmup                       Drinks or seconds to run before measuring.    \n");
+		fprintf(stderr, "    clock                        virtual (default) or real.                    \n");
+		fprintf(stderr, "    cores                        CPUs to pin drinkers to, one shard each.      \n");
 		Pause();
 		return 1;
 	}
@@ -473,6 +2453,94 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
+	poolOfResources.acquireMode = AcquireMode::Scan;
+	if (argc >= 5)
+	{
+		if (strcmp(argv[4], "pair") == 0)
+		{
+			poolOfResources.acquireMode = AcquireMode::Pair;
+		}
+		else if (strcmp(argv[4], "broker") == 0)
+		{
+			poolOfResources.acquireMode = AcquireMode::Broker;
+		}
+		else if (strcmp(argv[4], "block") == 0)
+		{
+			poolOfResources.acquireMode = AcquireMode::Block;
+		}
+		else if (strcmp(argv[4], "aging") == 0)
+		{
+			poolOfResources.acquireMode = AcquireMode::Aging;
+		}
+		else if (strcmp(argv[4], "shard") == 0)
+		{
+			poolOfResources.acquireMode = AcquireMode::Sharded;
+		}
+		else if (strcmp(argv[4], "scan") != 0)
+		{
+			fprintf(stderr, "Error: acquire must be scan, pair, broker, block, aging or shard.\n");
+			Pause();
+			return 1;
+		}
+	}
+
+	if (argc >= 6)
+	{
+		timedRun = true;
+		if (ParseRunLength(argv[5], &runLength) == false || (runLength.drinks == 0 && runLength.seconds <= 0.0))
+		{
+			fprintf(stderr, "Error: length must be a positive number of drinks or seconds.\n");
+			Pause();
+			return 1;
+		}
+	}
+
+	if (argc >= 7 && ParseRunLength(argv[6], &warmup) == false)
+	{
+		fprintf(stderr, "Error: warmup must be a number of drinks or seconds.\n");
+		Pause();
+		return 1;
+	}
+
+	if ((runLength.drinks > 0 || warmup.drinks > 0) && (drinkerCount == 0 || bottleCount == 0 || openerCount == 0))
+	{
+		fprintf(stderr, "Error: A length or warmup in drinks needs at least one drinker, bottle and opener.\n");
+		Pause();
+		return 1;
+	}
+
+	if (argc >= 8)
+	{
+		if (strcmp(argv[7], "real") == 0)
+		{
+			virtualClock = false;
+		}
+		else if (strcmp(argv[7], "virtual") != 0)
+		{
+			fprintf(stderr, "Error: clock must be virtual or real.\n");
+			Pause();
+			return 1;
+		}
+	}
+
+	if (argc == 9)
+	{
+		cores = atoi(argv[8]);
+		if (cores <= 0)
+		{
+			fprintf(stderr, "Error: cores must be a positive integer value.\n");
+			Pause();
+			return 1;
+		}
+	}
+
+	// Only parsed values go in, argv[4] has already been matched against the modes
+	char counts[128];
+	sprintf(counts, "\"drinkerCount\": %d, \"bottleCount\": %d, \"openerCount\": %d", drinkerCount, bottleCount, openerCount);
+	settings = std::string(counts) + ", \"acquire\": \"" + ((argc >= 5) ? argv[4] : "scan") + "\", \"clock\": \"" +
+		(virtualClock ? "virtual" : "real") + "\", \"length\": \"" + (timedRun ? FormatRunLength(runLength) : std::string()) +
+		"\", \"warmup\": \"" + FormatRunLength(warmup) + "\", \"cores\": " + std::to_string(cores);
+
 	printf("%s starting %d drinker(s), %d bottle(s), %d opener(s)\n", argv[0], drinkerCount, bottleCount, openerCount);
 
 	// Initialize drinker pool
@@ -488,17 +2556,28 @@ int main(int argc, char **argv)
 
 	// Initialize resource pool
 	poolOfResources.totalResources = resourceCount;
-	poolOfResources.resources = new Resource[resourceCount];
 
-	// Initialize individual resources
-	for (int i = 0; i < resourceCount; i++)
+	// Initialize the shelves, bottles get the lower ids
+	InitShelf(&poolOfResources.bottles, ResourceType::Bottle, 0, bottleCount);
+	InitShelf(&poolOfResources.openers, ResourceType::Opener, bottleCount, openerCount);
+
+	// One shard per pinned CPU, otherwise one per CPU the drinkers may run on
+	poolOfResources.pinnedCpus = cores;
+	poolOfResources.shardCount = (cores > 0) ? cores : (int)std::thread::hardware_concurrency();
+	if (poolOfResources.shardCount <= 0)
 	{
-		poolOfResources.resources[i].id = i;
-		poolOfResources.resources[i].type = (i < bottleCount) ? ResourceType::Bottle : ResourceType::Opener;
-		poolOfResources.resources[i].lockCount = 0;
-		poolOfResources.resources[i].useCount = 0;
+		poolOfResources.shardCount = 1;
 	}
 
+	// Initialize the broker
+	poolOfResources.waitingDrinkers = new Drinker*[(drinkerCount > 0) ? drinkerCount : 1];
+	poolOfResources.waitingHead = 0;
+	poolOfResources.waitingCount = 0;
+	poolOfResources.stopBrokerFlag = false;
+
+	// One device read seeds every drinker's generator
+	FastRand seeds(FastRand::DeviceSeed());
+
 	// Initialize individual drinkers
 	for (int i = 0; i < drinkerCount; i++)
 	{
@@ -507,10 +2586,56 @@ int main(int argc, char **argv)
 		poolOfDrinkers.drinkers[i].id = i;
 		poolOfDrinkers.drinkers[i].drinkCount = 0;
 		poolOfDrinkers.drinkers[i].resourceTryCount = 0;
-		poolOfDrinkers.drinkers[i].bottle = nullptr;
-		poolOfDrinkers.drinkers[i].opener = nullptr;		
-		poolOfDrinkers.drinkers[i].myRand.Init(0, INT_MAX);
+		poolOfDrinkers.drinkers[i].homeShard = i % poolOfResources.shardCount;
+		poolOfDrinkers.drinkers[i].stealCount = 0;
+		poolOfDrinkers.drinkers[i].bottle = -1;
+		poolOfDrinkers.drinkers[i].opener = -1;
+		poolOfDrinkers.drinkers[i].wantedShelf = nullptr;		
+		poolOfDrinkers.drinkers[i].waitStart = -1;
+		poolOfDrinkers.drinkers[i].myRand.Seed(seeds());
+
+		for (int b = 0; b < WaitHistogram::BucketCount; b++)
+		{
+			poolOfDrinkers.drinkers[i].waits.counts[b] = 0;
+		}
+#if ENABLE_LOCK_GRAPH
+		poolOfDrinkers.drinkers[i].lockEvents.head = 0;
+		poolOfDrinkers.drinkers[i].lockEvents.tail = 0;
+#endif
+
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////
+	// In virtual time there are no threads to start or stop.
+	///////////////////////////////////////////////////////////////////////////////////
+	if (timedRun && virtualClock)
+	{
+		Simulation sim;
+		RunSnapshot windowStart;
+		RunSnapshot windowEnd;
+		std::chrono::steady_clock::time_point simStarted = std::chrono::steady_clock::now();
+
+		InitSimulation(&sim, &poolOfDrinkers, &poolOfResources);
+		bool running = RunSimulation(&sim, warmup);
+		TakeSnapshot(poolOfDrinkers, poolOfResources, sim.now / 1000.0, &windowStart);
+		if (running)
+		{
+			RunSimulation(&sim, runLength);
+		}
+		TakeSnapshot(poolOfDrinkers, poolOfResources, sim.now / 1000.0, &windowEnd);
+
+		std::chrono::duration<double> wallTime = std::chrono::steady_clock::now() - simStarted;
+		printf("Simulation: %lld events, %.1f virtual seconds in %.2f seconds\n\n", sim.eventCount, sim.now / 1000.0, wallTime.count());
 
+		PrintResults(poolOfDrinkers, poolOfResources, sim.now / 1000.0);
+		ReportWindow(poolOfResources, windowStart, windowEnd, settings.c_str(), "drinking_results.json");
+
+		delete[] poolOfDrinkers.drinkers;
+		FreeShelf(&poolOfResources.bottles);
+		FreeShelf(&poolOfResources.openers);
+		delete[] poolOfResources.waitingDrinkers;
+
+		return 0;
 	}
 
 	///////////////////////////////////////////////////////////////////////////////////
@@ -519,6 +2644,47 @@ int main(int argc, char **argv)
 
 	for (int i = 0; i < drinkerCount; i++)
 		std::thread(DrinkerThreadEntrypoint, &poolOfDrinkers.drinkers[i]).detach();
+
+	std::thread broker;
+	if (poolOfResources.acquireMode == AcquireMode::Broker || poolOfResources.acquireMode == AcquireMode::Aging)
+	{
+		broker = std::thread(BrokerThreadEntrypoint, &poolOfResources, drinkerCount);
+	}
+
+#if ENABLE_LOCK_GRAPH
+	// Initialize the lock graph, nobody holds or waits for anything yet
+	LockGraph lockGraph;
+	lockGraph.totalResources = resourceCount;
+	lockGraph.bottleCount = bottleCount;
+	lockGraph.owner = new int[resourceCount];
+	lockGraph.ownerGeneration = new int[resourceCount];
+	lockGraph.waitingFor = new int[drinkerCount];
+	lockGraph.heldBottles = new int[drinkerCount];
+	lockGraph.heldOpeners = new int[drinkerCount];
+	lockGraph.quietChecks = new int[drinkerCount];
+	lockGraph.reported = new bool[drinkerCount];
+	lockGraph.deadlockCount = 0;
+	lockGraph.bottleThenOpener = 0;
+	lockGraph.openerThenBottle = 0;
+	lockGraph.stopFlag = false;
+
+	for (int i = 0; i < resourceCount; i++)
+	{
+		lockGraph.owner[i] = -1;
+		lockGraph.ownerGeneration[i] = 0;
+	}
+
+	for (int i = 0; i < drinkerCount; i++)
+	{
+		lockGraph.waitingFor[i] = -1;
+		lockGraph.heldBottles[i] = 0;
+		lockGraph.heldOpeners[i] = 0;
+		lockGraph.quietChecks[i] = 0;
+		lockGraph.reported[i] = false;
+	}
+
+	std::thread lockGraphChecker(LockGraphThreadEntrypoint, &lockGraph, &poolOfDrinkers);
+#endif
 	///////////////////////////////////////////////////////////////////////////////////
 	//   Wait for all drinkers to be ready. Wait for changes in the pool of drinkers 
 	//   to avoid burning CPU cycles.
@@ -534,18 +2700,40 @@ int main(int argc, char **argv)
 	// Start all of the drinkers. All of the drinkers must be ready by this point. 
 	///////////////////////////////////////////////////////////////////////////////////
 
+	std::chrono::steady_clock::time_point gunFired = std::chrono::steady_clock::now();
 	poolOfDrinkers.startingGunMutex.lock();
 	gunopen = true;
 	poolOfDrinkers.startingGunCondition.notify_all();
 	poolOfDrinkers.startingGunMutex.unlock();
 
-	// Wait for user input before telling the drinkers to stop
-	Pause();
+	RunSnapshot windowStart;
+	RunSnapshot windowEnd;
+
+	if (timedRun)
+	{
+		// Warm up, then measure between two snapshots before telling the drinkers to stop
+		bool running = WaitForRun(poolOfDrinkers, warmup);
+		std::chrono::duration<double> warmupTime = std::chrono::steady_clock::now() - gunFired;
+		TakeSnapshot(poolOfDrinkers, poolOfResources, warmupTime.count(), &windowStart);
+
+		if (running)
+		{
+			WaitForRun(poolOfDrinkers, runLength);
+		}
+		std::chrono::duration<double> runTime = std::chrono::steady_clock::now() - gunFired;
+		TakeSnapshot(poolOfDrinkers, poolOfResources, runTime.count(), &windowEnd);
+	}
+	else
+	{
+		// Wait for user input before telling the drinkers to stop
+		Pause();
+	}
 
 	///////////////////////////////////////////////////////////////////////////////////
 	// Set the stopDrinkingFlag so the drinkers break out of their drinking loop.
 	///////////////////////////////////////////////////////////////////////////////////
 
+	std::chrono::duration<double> drinkingTime = std::chrono::steady_clock::now() - gunFired;
 	poolOfDrinkers.startingGunMutex.lock();
 	poolOfDrinkers.stopDrinkingFlag = true;
 	poolOfDrinkers.startingGunCondition.notify_all();
@@ -556,7 +2744,21 @@ int main(int argc, char **argv)
 	///////////////////////////////////////////////////////////////////////////////////
 	poolOfResources.poolMutex.lock();
 	poolOfResources.poolCondition.notify_all();
+	poolOfResources.bottles.waitCondition.notify_all();
+	poolOfResources.openers.waitCondition.notify_all();
 	poolOfResources.poolMutex.unlock();
+
+	///////////////////////////////////////////////////////////////////////////////////
+	//   Stop the broker. It lets go of every drinker still waiting for a pair.
+	///////////////////////////////////////////////////////////////////////////////////
+	if (broker.joinable())
+	{
+		poolOfResources.brokerMutex.lock();
+		poolOfResources.stopBrokerFlag = true;
+		poolOfResources.brokerCondition.notify_one();
+		poolOfResources.brokerMutex.unlock();
+		broker.join();
+	}
 	
 	///////////////////////////////////////////////////////////////////////////////////
 	// Wait for all drinkers to finish.
@@ -564,15 +2766,53 @@ int main(int argc, char **argv)
 	locked.lock();
 	poolOfDrinkers.drinkerCountCondition.wait(locked, [&](){return poolOfDrinkers.drinkerCount == 0; });
 	locked.unlock();
-	PrintResults(poolOfDrinkers, poolOfResources);
+	PrintResults(poolOfDrinkers, poolOfResources, drinkingTime.count());
+
+	if (timedRun)
+	{
+		ReportWindow(poolOfResources, windowStart, windowEnd, settings.c_str(), "drinking_results.json");
+	}
+
+#if ENABLE_LOCK_GRAPH
+	///////////////////////////////////////////////////////////////////////////////////
+	// Stop the lock graph checker once it has read the last events.
+	///////////////////////////////////////////////////////////////////////////////////
+	lockGraph.stopMutex.lock();
+	lockGraph.stopFlag = true;
+	lockGraph.stopCondition.notify_one();
+	lockGraph.stopMutex.unlock();
+	lockGraphChecker.join();
+
+	printf("Lock graph: %d deadlock(s) found, opener locked while holding a bottle %d times, bottle locked while holding an opener %d times\n",
+		lockGraph.deadlockCount, lockGraph.bottleThenOpener, lockGraph.openerThenBottle);
+	if (lockGraph.bottleThenOpener > 0 && lockGraph.openerThenBottle > 0)
+	{
+		printf("Lock graph: bottles and openers were locked in both orders, so blocking on the second one can deadlock\n");
+	}
+	printf("\n");
+#endif
 
 	///////////////////////////////////////////////////////////////////////////////////
 	// Clean up.
 	///////////////////////////////////////////////////////////////////////////////////
 
 	delete[] poolOfDrinkers.drinkers;
-	delete[] poolOfResources.resources;
+	FreeShelf(&poolOfResources.bottles);
+	FreeShelf(&poolOfResources.openers);
+#if ENABLE_LOCK_GRAPH
+	delete[] lockGraph.owner;
+	delete[] lockGraph.ownerGeneration;
+	delete[] lockGraph.waitingFor;
+	delete[] lockGraph.heldBottles;
+	delete[] lockGraph.heldOpeners;
+	delete[] lockGraph.quietChecks;
+	delete[] lockGraph.reported;
+#endif
+	delete[] poolOfResources.waitingDrinkers;
 
-	Pause();
+	if (timedRun == false)
+	{
+		Pause();
+	}
 	return 0;
 }
@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  ArrivalQueue.cpp
+// Job:   holds the ArrivalQueue definitions 
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "ArrivalQueue.h"
+
+using namespace std;
+
+ArrivalQueue::ArrivalQueue(void)
+{
+	longestBacklog = 0;
+	stopped = false;
+	stopCallback = nullptr;
+}
+
+ArrivalQueue::~ArrivalQueue(void)
+{
+	delete stopCallback;
+}
+
+size_t ArrivalQueue::getBacklog(void)
+{
+	lock_guard<mutex> queueLock(queueMutex);
+	return arrivals.size();
+}
+
+size_t ArrivalQueue::getLongestBacklog(void)
+{
+	lock_guard<mutex> queueLock(queueMutex);
+	return longestBacklog;
+}
+
+void ArrivalQueue::setStopToken(const StopToken& token)
+{
+	delete stopCallback;
+	stopCallback = new StopCallback(token, [this](){ this->stop(); });
+}
+
+void ArrivalQueue::stop(void)
+{
+	queueMutex.lock();
+	{
+		stopped = true;
+		queueCondition.notify_all();
+	}
+	queueMutex.unlock();
+}
+
+void ArrivalQueue::push(chrono::steady_clock::time_point due)
+{
+	queueMutex.lock();
+	{
+		if (stopped == false)
+		{
+			arrivals.push_back(due);
+			if (arrivals.size() > longestBacklog)
+			{
+				longestBacklog = arrivals.size();
+			}
+			queueCondition.notify_one();
+		}
+	}
+	queueMutex.unlock();
+}
+
+bool ArrivalQueue::pop(chrono::steady_clock::time_point* due)
+{
+	unique_lock<mutex> queueUnique(queueMutex);
+
+	while ((arrivals.empty() == true) && (stopped == false))
+	{
+		queueCondition.wait(queueUnique);
+	}
+
+	// arrivals still waiting when the test ends are left undriven
+	if (stopped == true)
+	{
+		return false;
+	}
+
+	*due = arrivals.front();
+	arrivals.pop_front();
+	return true;
+}
@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  ArrivalQueue.h
+// Job:   holds the ArrivalQueue class 
+//////////////////////////////////////////////////////////////////////////////////
+
+// mult protection
+#ifndef _ARRIVALQUEUE_
+#define _ARRIVALQUEUE_
+
+// include needed files
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+
+#include "StopToken.h"
+
+// class ArrivalQueue
+//
+// Cars that have pulled into town on the open loop schedule and are waiting for a 
+// driver. Each arrival keeps the time it was due, not the time a driver got to it, 
+// so a backlog of arrivals shows up in the queueing delay instead of quietly slowing
+// the arrivals down.
+class ArrivalQueue
+{
+private:
+	//Variables
+	std::deque<std::chrono::steady_clock::time_point> arrivals;	// arrival times not picked up yet, oldest first
+	std::mutex queueMutex;										// mutex for protecting the arrivals
+	std::condition_variable queueCondition;						// cv idle drivers wait on
+	size_t longestBacklog;										// most arrivals ever waiting at once
+	bool stopped;												// set once the test is over
+	StopCallback* stopCallback;									// wakes the idle drivers when the test ends
+
+	// disable copying, the stop callback points at the queue
+	ArrivalQueue(const ArrivalQueue&);
+	ArrivalQueue& operator=(const ArrivalQueue&);
+
+	// wakes every idle driver and turns away new arrivals, run by the stop callback
+	void stop(void);
+
+public:
+	//constructor and destructor
+	ArrivalQueue(void);
+	~ArrivalQueue(void);
+
+	//accessors
+	size_t getBacklog(void);
+	size_t getLongestBacklog(void);
+
+	// mutators
+	void setStopToken(const StopToken& token);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		push
+	//
+	// Arguments:	due - when the car was due to arrive
+	//
+	// Notes:		This function will queue the arrival and wake one driver
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void push(std::chrono::steady_clock::time_point due);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		pop
+	//
+	// Arguments:	due - set to when the oldest arrival was due
+	//
+	// Notes:		This function will wait for an arrival, the oldest one 
+	//				is taken first
+	//
+	// Returns:		bool - false once the test is over and there is nothing
+	//				more to drive
+	//////////////////////////////////////////////////////////////////////
+	bool pop(std::chrono::steady_clock::time_point* due);
+};
+
+#endif
@@ -0,0 +1,179 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  Benchmark.cpp
+// Job:   holds the micro benchmark definitions 
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "Benchmark.h"
+#include "PumpBitmap.h"
+#include "CarCounters.h"
+
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+static const int claimsPerRun = 1000000;
+
+// nanoseconds per claim/release pair on one thread
+static double timeClaims(PumpBitmap& bitmap)
+{
+	chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+
+	for (int i = 0; i < claimsPerRun; i++)
+	{
+		bitmap.release(bitmap.claim());
+	}
+
+	chrono::nanoseconds elapsed = chrono::high_resolution_clock::now() - start;
+	return (double)elapsed.count() / claimsPerRun;
+}
+
+// nanoseconds per claim/release pair with threadCount threads sharing the bitmap
+static double timeContendedClaims(PumpBitmap& bitmap, int threadCount)
+{
+	vector<thread> threads;
+	chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+
+	for (int t = 0; t < threadCount; t++)
+	{
+		threads.push_back(thread([&bitmap, threadCount]()
+		{
+			for (int i = 0; i < claimsPerRun / threadCount; i++)
+			{
+				int pump = bitmap.claim();
+				if (pump != -1)
+				{
+					bitmap.release(pump);
+				}
+			}
+		}));
+	}
+
+	for (size_t t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+
+	chrono::nanoseconds elapsed = chrono::high_resolution_clock::now() - start;
+	return (double)elapsed.count() / claimsPerRun;
+}
+
+void benchmarkPumpClaims(void)
+{
+	const int pumpCounts[] = { 8, 64, 512, 4096 };
+	int threadCount = (int)thread::hardware_concurrency();
+	if (threadCount < 2)
+	{
+		threadCount = 2;
+	}
+
+	cout << "Pump claim latency (ns per claim + release, " << claimsPerRun << " claims)" << endl;
+	cout << setw(8) << "pumps" << setw(12) << "empty" << setw(12) << "last free" << setw(10) << "threads" << setw(12) << "contended" << endl;
+
+	for (int p = 0; p < (int)(sizeof(pumpCounts) / sizeof(pumpCounts[0])); p++)
+	{
+		int pumps = pumpCounts[p];
+		PumpBitmap bitmap;
+
+		bitmap.create(pumps);
+		double emptyTime = timeClaims(bitmap);
+
+		// take every pump but the last one so a claim has to get past all the full leaves
+		for (int i = 0; i < pumps - 1; i++)
+		{
+			bitmap.claim();
+		}
+		double lastFreeTime = timeClaims(bitmap);
+
+		bitmap.create(pumps);
+		double contendedTime = timeContendedClaims(bitmap, threadCount);
+
+		cout << fixed << setprecision(1);
+		cout << setw(8) << pumps << setw(12) << emptyTime << setw(12) << lastFreeTime << setw(10) << threadCount << setw(12) << contendedTime << endl;
+	}
+}
+
+static const int incrementsPerThread = 10000000;
+
+// the fill and try counts the way they used to sit inside neighbouring Cars
+struct PackedCounters
+{
+	int fillCount;
+	int tryCount;
+};
+
+// nanoseconds per increment with every thread bumping the counters it is handed,
+// volatile so each increment really goes to memory like the car's counts do
+static double timeIncrements(vector<volatile int*>& fills, vector<volatile int*>& tries)
+{
+	vector<thread> threads;
+	chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+
+	for (size_t t = 0; t < fills.size(); t++)
+	{
+		volatile int* fill = fills[t];
+		volatile int* tryCount = tries[t];
+
+		threads.push_back(thread([fill, tryCount]()
+		{
+			for (int i = 0; i < incrementsPerThread; i++)
+			{
+				*tryCount = *tryCount + 1;
+				*fill = *fill + 1;
+			}
+		}));
+	}
+
+	for (size_t t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+
+	chrono::nanoseconds elapsed = chrono::high_resolution_clock::now() - start;
+	return (double)elapsed.count() / ((double)incrementsPerThread * fills.size());
+}
+
+void benchmarkCounters(void)
+{
+	int threadCount = (int)thread::hardware_concurrency();
+	if (threadCount < 32)
+	{
+		threadCount = 32;
+	}
+
+	PackedCounters* packed = new PackedCounters[threadCount];
+	CounterSlots padded;
+	padded.create(threadCount);
+
+	vector<volatile int*> fills;
+	vector<volatile int*> tries;
+
+	for (int t = 0; t < threadCount; t++)
+	{
+		packed[t].fillCount = 0;
+		packed[t].tryCount = 0;
+		fills.push_back(&packed[t].fillCount);
+		tries.push_back(&packed[t].tryCount);
+	}
+	double packedTime = timeIncrements(fills, tries);
+
+	fills.clear();
+	tries.clear();
+	for (int t = 0; t < threadCount; t++)
+	{
+		fills.push_back(&padded.getSlot(t)->fillCount);
+		tries.push_back(&padded.getSlot(t)->tryCount);
+	}
+	double paddedTime = timeIncrements(fills, tries);
+
+	cout << "Counter increments (ns per fill + try increment, " << threadCount << " threads on ";
+	cout << thread::hardware_concurrency() << " hardware threads)" << endl;
+	cout << fixed << setprecision(2);
+	cout << setw(10) << "packed" << setw(10) << packedTime << endl;
+	cout << setw(10) << "padded" << setw(10) << paddedTime << endl;
+
+	delete []packed;
+}
@@ -0,0 +1,38 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  Benchmark.h
+// Job:   holds the micro benchmarks for the reservation system 
+//////////////////////////////////////////////////////////////////////////////////
+
+// mult protection
+#ifndef _BENCHMARK_
+#define _BENCHMARK_
+
+///////////////////////////////////////////////////////////////////////
+// Name:		benchmarkPumpClaims
+//
+// Arguments:	void
+//
+// Notes:		This function will time claim/release pairs on the pump 
+//				bitmap at 8, 64, 512 and 4096 pumps, with an empty station,
+//				with only the last pump free and with every hardware thread
+//				fighting over the pumps
+//
+// Returns:		void
+//////////////////////////////////////////////////////////////////////
+void benchmarkPumpClaims(void);
+
+///////////////////////////////////////////////////////////////////////
+// Name:		benchmarkCounters
+//
+// Arguments:	void
+//
+// Notes:		This function will time threads bumping their own fill and 
+//				try counts, once with the counts packed next to each other
+//				like they were inside the Car array and once with the 
+//				cache line padded CounterSlots
+//
+// Returns:		void
+//////////////////////////////////////////////////////////////////////
+void benchmarkCounters(void);
+
+#endif
@@ -4,6 +4,7 @@
 //////////////////////////////////////////////////////////////////////////////////
 #include "Car.h"
 #include "Station.h"
+#include "StationNetwork.h"
 
 using namespace std;
 
@@ -11,10 +12,12 @@ extern void testACar(void*);
 
 Car::Car(void) 
 {
-	fillCount = 0;
-	tryCount = 0;
+	counters = nullptr;
 	thread = nullptr;
 	stationToUse = nullptr;
+	network = nullptr;
+	arrivals = nullptr;
+	stealSeed = 1;
 	numberWaitingInLine = nullptr;
 }
 
@@ -24,33 +27,106 @@ Car::~Car(void)
 
 int Car::getFillCount(void)
 {
-	return this->fillCount;
+	return this->counters->fillCount;
 }
 
 int Car::getTryCount(void)
 {
-	return this->tryCount;
+	return this->counters->tryCount;
+}
+
+const Histogram& Car::getWaitTimes(void)
+{
+	return this->counters->waitTimes;
+}
+
+const Histogram& Car::getServiceTimes(void)
+{
+	return this->counters->serviceTimes;
+}
+
+ArrivalQueue* Car::getArrivals(void)
+{
+	return this->arrivals;
+}
+
+void Car::setArrivals(ArrivalQueue *queue)
+{
+	this->arrivals = queue;
 }
 
 int Car::fillTank(void)
 {
 	int result;
+	chrono::microseconds waitTime;
+	chrono::microseconds serviceTime;
 
 	if(stationToUse == nullptr)
 		return -1;
 
-	tryCount++;
+	recordTry();
 
-	result = stationToUse->fillUp();
+	Station* station = pickStation();
+	result = station->fillUp(chrono::steady_clock::now(), &waitTime, &serviceTime);
 
 	if(result == 1)
 	{
-		this->fillCount++;
+		recordFill(waitTime.count());
+		recordService(serviceTime.count());
+		station->rest();
 	}
 
 	return 1;
 }
 
+int Car::driveArrival(chrono::steady_clock::time_point due)
+{
+	int result;
+	chrono::microseconds waitTime;
+	chrono::microseconds serviceTime;
+
+	if(stationToUse == nullptr)
+		return -1;
+
+	recordTry();
+
+	result = pickStation()->fillUp(due, &waitTime, &serviceTime);
+
+	if(result == 1)
+	{
+		recordFill(waitTime.count());
+		recordService(serviceTime.count());
+	}
+
+	return 1;
+}
+
+void Car::recordTry(void)
+{
+	this->counters->tryCount++;
+}
+
+void Car::recordFill(long long waitTime)
+{
+	this->counters->fillCount++;
+	this->counters->waitTimes.record(waitTime);
+}
+
+void Car::recordService(long long serviceTime)
+{
+	this->counters->serviceTimes.record(serviceTime);
+}
+
+Station* Car::pickStation(void)
+{
+	if(network == nullptr)
+	{
+		return stationToUse;
+	}
+
+	return network->pickStation(stationToUse, &stealSeed);
+}
+
 void Car::startCar(void testACar(Car* car))
 {
 	///////////////////////////////////////////////////////////////////////////
@@ -78,6 +154,19 @@ void Car::setStationToUse(Station *myStation)
 	stationToUse = myStation;	
 }
 
+void Car::setCounters(CarCounters* c)
+{
+	counters = c;
+}
+
+void Car::setNetwork(StationNetwork *myNetwork, unsigned int seed)
+{
+	network = myNetwork;
+
+	// xorshift never leaves 0 so keep the seed odd
+	stealSeed = seed | 1;
+}
+
 void Car::setCountMutex(std::mutex* m)
 {
 	this->countMutex = m;
@@ -113,9 +202,9 @@ void Car::decNumberWaitingInLine()
 	(*(this->numberWaitingInLine))--;
 }
 
-void Car::setTestOver(bool* b)
+void Car::setStopToken(const StopToken& token)
 {
-	this->testOver = b;
+	this->stopToken = token;
 }
 
 Station* Car::getStationToUse(void)
@@ -143,7 +232,7 @@ std::condition_variable* Car::getGunCondition(void)
 	return this->gunCondition;
 }
 
-bool* Car::getTestOver(void)
+const StopToken& Car::getStopToken(void)
 {
-	return this->testOver;
+	return this->stopToken;
 }
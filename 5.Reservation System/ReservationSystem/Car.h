@@ -11,21 +11,29 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <chrono>
+
+#include "CarCounters.h"
+#include "StopToken.h"
 
 // forward declarations
 class Station;
+class ArrivalQueue;
+class StationNetwork;
 
 // class Car
 class Car
 {
 private:
 	//Variables
-	int fillCount;							// count of the fills
-	int tryCount;							// count of the tries to fill
+	CarCounters* counters;					// fill and try counts, on a cache line of their own
 	int* numberWaitingInLine;				// number of cars on the starting line
-	bool* testOver;							// test over boolean
+	StopToken stopToken;					// token that ends the test
 	std::thread *thread;					// thread for the car
-	Station *stationToUse;					// station used for this car
+	Station *stationToUse;					// home station used for this car
+	StationNetwork *network;				// network the home station is part of, or null
+	ArrivalQueue *arrivals;					// arrivals the car drives in the open loop test, or null
+	unsigned int stealSeed;					// random state for picking other stations
 	std::mutex* countMutex;					// mutex for protecting the counts
 	std::mutex* gunMutex;					// mutex for protecting the gun
 	std::condition_variable* gunCondition;	// cv used for scheduling for the gun
@@ -39,15 +47,21 @@ public:
 	// accessors  
 	int getFillCount(void);
 	int getTryCount(void);
+	const Histogram& getWaitTimes(void);
+	const Histogram& getServiceTimes(void);
+	ArrivalQueue* getArrivals(void);
 	Station* getStationToUse(void);
 	std::mutex* getCountMutex(void);
 	std::condition_variable* getCountCondition(void);
 	std::mutex* getGunMutex(void);
 	std::condition_variable* getGunCondition(void);
-	bool* getTestOver(void);
+	const StopToken& getStopToken(void);
 
 	// mutators
 	void setStationToUse(Station *myStation);
+	void setCounters(CarCounters* c);
+	void setNetwork(StationNetwork *myNetwork, unsigned int seed);
+	void setArrivals(ArrivalQueue *queue);
 	void setCountMutex(std::mutex* m);
 	void setCountCondition(std::condition_variable* cv);
 	void setGunMutex(std::mutex* m);
@@ -55,7 +69,52 @@ public:
 	void setNumberStandingInLine(int* num);
 	void incNumberWaitingInLine();
 	void decNumberWaitingInLine();
-	void setTestOver(bool* b);
+	void setStopToken(const StopToken& token);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		recordTry
+	//
+	// Arguments:	void
+	//
+	// Notes:		This function will inc the try count
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void recordTry(void);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		recordFill
+	//
+	// Arguments:	waitTime - microseconds the car waited for its pump
+	//
+	// Notes:		This function will inc the fill count and keep the wait time
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void recordFill(long long waitTime);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		recordService
+	//
+	// Arguments:	serviceTime - microseconds the car spent at its pump
+	//
+	// Notes:		This function will keep the service time once the fill is done
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void recordService(long long serviceTime);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		pickStation
+	//
+	// Arguments:	void
+	//
+	// Notes:		This function will pick where to fill up this time, the
+	//				home station unless the network finds a less loaded one
+	//
+	// Returns:		Station* - station to fill up at
+	//////////////////////////////////////////////////////////////////////
+	Station* pickStation(void);
 
 
 	///////////////////////////////////////////////////////////////////////
@@ -87,11 +146,23 @@ public:
 	// Arguments:	void
 	//
 	// Notes:		This function will inc the try count, fill count and 
-	//				call the stations fillup function
+	//				call the stations fillup function, then rest
 	//
 	// Returns:		int - (1) if the fill up was successful and (-1) if it failed
 	//////////////////////////////////////////////////////////////////////
 	int fillTank(void);	
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		driveArrival
+	//
+	// Arguments:	due - when the arrival was due at the station
+	//
+	// Notes:		This function will fill up for one open loop arrival, the 
+	//				wait counts from when it was due and there is no rest after
+	//
+	// Returns:		int - (1) if the fill up was successful and (-1) if it failed
+	//////////////////////////////////////////////////////////////////////
+	int driveArrival(std::chrono::steady_clock::time_point due);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,52 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  CarCounters.cpp
+// Job:   holds the CounterSlots definitions 
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "CarCounters.h"
+
+#include <new>
+
+using namespace std;
+
+CounterSlots::CounterSlots(void)
+{
+	memory = nullptr;
+	firstSlot = nullptr;
+	slotSize = ((sizeof(CarCounters) + cacheLineSize - 1) / cacheLineSize) * cacheLineSize;
+	slotCount = 0;
+}
+
+CounterSlots::~CounterSlots(void)
+{
+	for (int i = 0; i < slotCount; i++)
+	{
+		getSlot(i)->~CarCounters();
+	}
+
+	delete []memory;
+}
+
+void CounterSlots::create(int numOfSlots)
+{
+	memory = new char[(numOfSlots * slotSize) + cacheLineSize];
+	firstSlot = memory + ((cacheLineSize - ((size_t)memory % cacheLineSize)) % cacheLineSize);
+	slotCount = numOfSlots;
+
+	for (int i = 0; i < numOfSlots; i++)
+	{
+		CarCounters* slot = new (firstSlot + (i * slotSize)) CarCounters();
+		slot->fillCount = 0;
+		slot->tryCount = 0;
+	}
+}
+
+CarCounters* CounterSlots::getSlot(int num)
+{
+	return (CarCounters*)(firstSlot + (num * slotSize));
+}
+
+int CounterSlots::getSlotCount(void)
+{
+	return slotCount;
+}
@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  CarCounters.h
+// Job:   holds the CarCounters struct and the CounterSlots class 
+//////////////////////////////////////////////////////////////////////////////////
+
+// mult protection
+#ifndef _CARCOUNTERS_
+#define _CARCOUNTERS_
+
+// include needed files
+#include "Histogram.h"
+
+// size of a cache line, counters written by different threads never share one
+static const int cacheLineSize = 64;
+
+// struct CarCounters
+//
+// Everything a car writes on every fill. Only the owning car's thread (or task) 
+// writes them, main reads them once the test is over.
+struct CarCounters
+{
+	int fillCount;							// count of the fills
+	int tryCount;							// count of the tries to fill
+	Histogram waitTimes;					// microseconds spent getting a pump, one per fill
+	Histogram serviceTimes;					// microseconds spent at the pump, one per finished fill
+};
+
+// class CounterSlots
+//
+// One CarCounters per car, each starting on its own cache line. The cars themselves
+// sit next to each other in one array, so keeping their counters inside Car would
+// have neighbouring cars on different threads writing to the same cache line.
+class CounterSlots
+{
+private:
+	//Variables
+	char* memory;							// raw allocation, over sized so the slots can be aligned
+	char* firstSlot;						// first cache line aligned slot
+	int slotSize;							// sizeof(CarCounters) rounded up to whole cache lines
+	int slotCount;							// number of slots
+
+	// disable copying, the slots own their memory
+	CounterSlots(const CounterSlots&);
+	CounterSlots& operator=(const CounterSlots&);
+
+public:
+	//constructor and destructor
+	CounterSlots(void);
+	~CounterSlots(void);
+
+	//accessors
+	CarCounters* getSlot(int num);
+	int getSlotCount(void);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		create
+	//
+	// Arguments:	numOfSlots - number of cars that need counters
+	//
+	// Notes:		This function will allocate and zero the slots
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void create(int numOfSlots);
+};
+
+#endif
@@ -0,0 +1,128 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  CarTask.cpp
+// Job:   holds the CarTask definitions 
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "CarTask.h"
+#include "Car.h"
+#include "Station.h"
+#include "Pump.h"
+
+using namespace std;
+
+CarTask::CarTask(void)
+{
+	car = nullptr;
+	stationInUse = nullptr;
+	scheduler = nullptr;
+	state = CarState::Arriving;
+	pumpIndex = -1;
+}
+
+CarTask::~CarTask(void)
+{
+}
+
+void CarTask::setCar(Car* c)
+{
+	car = c;
+}
+
+void CarTask::setScheduler(TaskScheduler* s)
+{
+	scheduler = s;
+}
+
+void CarTask::startFill(void)
+{
+	gotPump = chrono::steady_clock::now();
+	car->recordFill(chrono::duration_cast<chrono::microseconds>(gotPump - arrived).count());
+	stationInUse->getPump(pumpIndex)->recordFill();
+
+	state = CarState::Filling;
+	scheduler->submitAfter(this, chrono::milliseconds(Pump::fillTimeInMs));
+}
+
+void CarTask::run(void)
+{
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	//   Every path ends by handing the task to something that will run it again (the line, a 
+	//   timer) or by finishing it. After that the task can already be running on another 
+	//   worker, so nothing may touch it afterwards.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	switch (state)
+	{
+	case CarState::Arriving:
+	{
+		if (scheduler->isStopRequested() == true)
+		{
+			scheduler->finish();
+			return;
+		}
+
+		bool parked;
+		car->recordTry();
+		arrived = chrono::steady_clock::now();
+
+		stationInUse = car->pickStation();
+		int claimed = stationInUse->reservePump(this, &parked);
+		if (parked == true)
+		{
+			return;
+		}
+
+		// no pump and no line means the station has sent everyone home
+		if (claimed == -1)
+		{
+			scheduler->finish();
+			return;
+		}
+
+		pumpIndex = claimed;
+		startFill();
+		return;
+	}
+	case CarState::Handed:
+	{
+		if (pumpIndex == -1)
+		{
+			scheduler->finish();
+			return;
+		}
+
+		// pass the pump on down the line rather than start a fill during the stop
+		if (scheduler->isStopRequested() == true)
+		{
+			stationInUse->releasePump(pumpIndex);
+			scheduler->finish();
+			return;
+		}
+
+		startFill();
+		return;
+	}
+	case CarState::Filling:
+	{
+		stationInUse->releasePump(pumpIndex);
+		pumpIndex = -1;
+		car->recordService(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - gotPump).count());
+
+		if (scheduler->isStopRequested() == true)
+		{
+			scheduler->finish();
+			return;
+		}
+
+		state = CarState::Arriving;
+		scheduler->submitAfter(this, chrono::milliseconds(stationInUse->getRestTimeInMs()));
+		return;
+	}
+	}
+}
+
+void CarTask::unpark(int handedPump)
+{
+	state = CarState::Handed;
+	pumpIndex = handedPump;
+	scheduler->submit(this);
+}
@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  CarTask.h
+// Job:   holds the CarTask class 
+//////////////////////////////////////////////////////////////////////////////////
+
+// mult protection
+#ifndef _CARTASK_
+#define _CARTASK_
+
+// include needed files
+#include <chrono>
+
+#include "TaskScheduler.h"
+#include "ParkingSlot.h"
+
+// forward declarations
+class Car;
+class Station;
+
+// class CarTask
+//
+// Drives a Car through the station as a task instead of a thread. The task is its
+// own parking slot, so when every pump is busy it is put in the station's line and
+// the car that hands it a pump resubmits it to the scheduler. Each trip goes to the
+// station the car picks, its home or a less loaded station in the network.
+class CarTask : public Task, public ParkingSlot
+{
+private:
+	// where the car is in its trip to the station
+	enum class CarState
+	{
+		// pulling into the station to try for a pump
+		Arriving,
+		// a pump was handed over while parked in line
+		Handed,
+		// filling up at pumpIndex
+		Filling
+	};
+
+	//Variables
+	Car* car;												// car whose counts are kept
+	Station* stationInUse;									// station picked for the current trip
+	TaskScheduler* scheduler;								// scheduler the task runs on
+	CarState state;											// what run does next
+	int pumpIndex;											// pump the car holds or was handed
+	std::chrono::steady_clock::time_point arrived;			// when the car last pulled in
+	std::chrono::steady_clock::time_point gotPump;			// when the current fill started
+
+	// the car has a pump, fill up and come back when the tank is full
+	void startFill(void);
+
+public:
+	//constructor and destructor
+	CarTask(void);
+	~CarTask(void);
+
+	// mutators
+	void setCar(Car* c);
+	void setScheduler(TaskScheduler* s);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		run
+	//
+	// Arguments:	void
+	//
+	// Notes:		This function will run the next step of the car's loop of
+	//				arriving, filling and resting until a stop is requested
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void run(void);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		unpark
+	//
+	// Arguments:	handedPump - pump handed to the car or (-1) for none
+	//
+	// Notes:		This function will resubmit the parked task instead of
+	//				waking a thread
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void unpark(int handedPump);
+};
+
+#endif
@@ -0,0 +1,164 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  Histogram.cpp
+// Job:   holds the Histogram definitions 
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "Histogram.h"
+
+#include <cmath>
+
+using namespace std;
+
+// every power of two above the linear range is split into this many buckets
+static const int subBucketCount = 32;
+static const int subBucketBits = 5;
+
+Histogram::Histogram(void)
+{
+	totalCount = 0;
+	minValue = 0;
+	maxValue = 0;
+	sum = 0.0;
+}
+
+Histogram::~Histogram(void)
+{
+}
+
+int Histogram::bucketFor(long long value)
+{
+	// values below 64 map straight to their own bucket
+	if (value < 2 * subBucketCount)
+	{
+		return (int)value;
+	}
+
+	int topBit = 0;
+	while ((value >> (topBit + 1)) != 0)
+	{
+		topBit++;
+	}
+
+	// keep the top 6 bits, the leading one picks the power of two and the next 5 the sub bucket
+	int shift = topBit - subBucketBits;
+	return (shift * subBucketCount) + (int)(value >> shift);
+}
+
+long long Histogram::highestInBucket(int bucket)
+{
+	if (bucket < 2 * subBucketCount)
+	{
+		return bucket;
+	}
+
+	int shift = (bucket / subBucketCount) - 1;
+	long long subBucket = bucket - (shift * subBucketCount);
+	return ((subBucket + 1) << shift) - 1;
+}
+
+long long Histogram::getCount(void) const
+{
+	return totalCount;
+}
+
+long long Histogram::getMin(void) const
+{
+	return minValue;
+}
+
+long long Histogram::getMax(void) const
+{
+	return maxValue;
+}
+
+double Histogram::getMean(void) const
+{
+	return (totalCount == 0) ? 0.0 : (sum / totalCount);
+}
+
+void Histogram::record(long long value)
+{
+	if (value < 0)
+	{
+		value = 0;
+	}
+
+	int bucket = bucketFor(value);
+	if (bucket >= (int)counts.size())
+	{
+		counts.resize(bucket + 1, 0);
+	}
+	counts[bucket]++;
+
+	if ((totalCount == 0) || (value < minValue))
+	{
+		minValue = value;
+	}
+	if (value > maxValue)
+	{
+		maxValue = value;
+	}
+	totalCount++;
+	sum += (double)value;
+}
+
+void Histogram::add(const Histogram& other)
+{
+	if (other.totalCount == 0)
+	{
+		return;
+	}
+
+	if (other.counts.size() > counts.size())
+	{
+		counts.resize(other.counts.size(), 0);
+	}
+	for (size_t i = 0; i < other.counts.size(); i++)
+	{
+		counts[i] += other.counts[i];
+	}
+
+	if ((totalCount == 0) || (other.minValue < minValue))
+	{
+		minValue = other.minValue;
+	}
+	if (other.maxValue > maxValue)
+	{
+		maxValue = other.maxValue;
+	}
+	totalCount += other.totalCount;
+	sum += other.sum;
+}
+
+long long Histogram::valueAtPercentile(double percentile) const
+{
+	if (totalCount == 0)
+	{
+		return 0;
+	}
+
+	if (percentile <= 0.0)
+	{
+		return minValue;
+	}
+
+	// the rank of the value we want, 1 based so the 100th percentile is the last value
+	long long rank = (long long)ceil((percentile / 100.0) * totalCount);
+	if (rank < 1)
+	{
+		rank = 1;
+	}
+
+	long long seen = 0;
+	for (size_t i = 0; i < counts.size(); i++)
+	{
+		seen += counts[i];
+		if (seen >= rank)
+		{
+			long long highest = highestInBucket((int)i);
+			return (highest < maxValue) ? highest : maxValue;
+		}
+	}
+
+	return maxValue;
+}
@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  Histogram.h
+// Job:   holds the Histogram class 
+//////////////////////////////////////////////////////////////////////////////////
+
+// mult protection
+#ifndef _HISTOGRAM_
+#define _HISTOGRAM_
+
+// include needed files
+#include <vector>
+
+// class Histogram
+//
+// Log bucketed histogram in the style of HdrHistogram. Values below 64 get a bucket 
+// each, above that every power of two is split into 32 buckets, so any recorded value
+// is reported within about 3% no matter how large it is. A million waits cost the 
+// same few hundred counters as one, and histograms from many cars add together.
+class Histogram
+{
+private:
+	//Variables
+	std::vector<unsigned int> counts;		// count per bucket, only grown as far as the largest value
+	long long totalCount;					// number of values recorded
+	long long minValue;						// smallest value recorded
+	long long maxValue;						// largest value recorded
+	double sum;								// sum of the values, for the mean
+
+	// bucket a value falls in
+	static int bucketFor(long long value);
+
+	// largest value that falls in a bucket
+	static long long highestInBucket(int bucket);
+
+public:
+	//constructor and destructor
+	Histogram(void);
+	~Histogram(void);
+
+	//accessors
+	long long getCount(void) const;
+	long long getMin(void) const;
+	long long getMax(void) const;
+	double getMean(void) const;
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		record
+	//
+	// Arguments:	value - value to count, negative values count as zero
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void record(long long value);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		add
+	//
+	// Arguments:	other - histogram whose counts are added to this one
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void add(const Histogram& other);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		valueAtPercentile
+	//
+	// Arguments:	percentile - 0 to 100
+	//
+	// Notes:		This function will find the bucket holding the value at
+	//				the percentile and report the largest value of that bucket,
+	//				never more than the largest value recorded
+	//
+	// Returns:		long long - the value, or 0 if nothing was recorded
+	//////////////////////////////////////////////////////////////////////
+	long long valueAtPercentile(double percentile) const;
+};
+
+#endif
@@ -0,0 +1,55 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  ParkingSlot.cpp
+// Job:   holds the ParkingSlot definitions 
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "ParkingSlot.h"
+
+using namespace std;
+
+ParkingSlot::ParkingSlot(void)
+{
+	handedPump = -1;
+	signaled = false;
+	next = nullptr;
+}
+
+ParkingSlot::~ParkingSlot(void)
+{
+}
+
+int ParkingSlot::park(void)
+{
+	unique_lock<mutex> IamParked(slotMutex);
+
+	while (signaled == false)
+	{
+		slotCondition.wait(IamParked);
+	}
+
+	int pumpIndex = handedPump;
+	handedPump = -1;
+	signaled = false;
+
+	return pumpIndex;
+}
+
+void ParkingSlot::unpark(int pumpIndex)
+{
+	// notify while holding the mutex, the slot may be gone as soon as the car sees signaled
+	lock_guard<mutex> locked(slotMutex);
+
+	handedPump = pumpIndex;
+	signaled = true;
+	slotCondition.notify_one();
+}
+
+ParkingSlot* ParkingSlot::getNext(void)
+{
+	return next;
+}
+
+void ParkingSlot::setNext(ParkingSlot* slot)
+{
+	next = slot;
+}
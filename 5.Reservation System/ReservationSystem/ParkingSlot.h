@@ -0,0 +1,64 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  ParkingSlot.h
+// Job:   holds the ParkingSlot class 
+//////////////////////////////////////////////////////////////////////////////////
+
+// mult protection
+#ifndef _PARKINGSLOT_
+#define _PARKINGSLOT_
+
+// include needed files
+#include <mutex>
+#include <condition_variable>
+
+// class ParkingSlot
+//
+// A binary semaphore a single car sleeps on while it waits in the station's line.
+// The slot is also the link in the line so waiting never allocates. unpark is 
+// virtual so a car running as a task can be resubmitted instead of woken.
+class ParkingSlot
+{
+private:
+	//Variables
+	int handedPump;							// pump handed to the parked car or (-1) for none
+	bool signaled;							// set once unpark has been called
+	ParkingSlot* next;						// next car in the line
+	std::mutex slotMutex;					// mutex for protecting the slot
+	std::condition_variable slotCondition;	// cv the parked car sleeps on
+
+public:
+	//constructor and destructor
+	ParkingSlot(void);
+	virtual ~ParkingSlot(void);
+
+	// accessors  
+	ParkingSlot* getNext(void);
+
+	// mutators
+	void setNext(ParkingSlot* slot);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		park
+	//
+	// Arguments:	void
+	//
+	// Notes:		This function will block the calling car until unpark is
+	//				called, then reset the slot so it can be used again
+	//
+	// Returns:		int - the pump handed over or (-1) if there was none
+	//////////////////////////////////////////////////////////////////////
+	int park(void);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		unpark
+	//
+	// Arguments:	pumpIndex - pump handed to the car or (-1) for none
+	//
+	// Notes:		This function will wake only the car parked in this slot
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	virtual void unpark(int pumpIndex);
+};
+
+#endif
@@ -7,6 +7,8 @@
 
 using namespace std;
 
+const int Pump::fillTimeInMs;
+
 Pump::Pump(void)
 {
 	fillCount = 0;
@@ -18,9 +20,14 @@ Pump::~Pump(void)
 
 void Pump::fillTankUp(void)
 {
-	fillCount++;
+	recordFill();
 	
-	this_thread::sleep_for(chrono::milliseconds(30));
+	this_thread::sleep_for(chrono::milliseconds(fillTimeInMs));
+}
+
+void Pump::recordFill(void)
+{
+	fillCount++;
 }
 
 int Pump::getFillCount(void)
@@ -13,8 +13,11 @@ class Pump
 private:
 	//Variables
 	int fillCount;				//number of car fillup completed
+	char padding[64 - sizeof(int)];	//keeps each pump's fillCount on its own cache line in the Pump array
 
-public:	
+public:
+	static const int fillTimeInMs = 30;	// time it takes to fill a tank
+	
 	//constructor and destructor
 	Pump(void);					
 	~Pump(void);				
@@ -33,6 +36,18 @@ public:
 	// Returns:		void
 	//////////////////////////////////////////////////////////////////////
 	void fillTankUp(void);		
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		recordFill
+	//
+	// Arguments:	void
+	//
+	// Notes:		This function will increment the fill count without 
+	//				pausing, used by the simulation to fill in virtual time
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void recordFill(void);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,150 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  PumpBitmap.cpp
+// Job:   holds the PumpBitmap definitions 
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "PumpBitmap.h"
+
+using namespace std;
+
+static const unsigned long long allBits = ~0ull;
+
+// index of the lowest set bit, bits must not be 0
+#if defined _MSC_VER
+	#include <intrin.h>
+	static int countTrailingZeros(unsigned long long bits)
+	{
+		// _BitScanForward64 does not exist on Win32 so scan the two halves
+		unsigned long index;
+		if (_BitScanForward(&index, (unsigned long)bits))
+		{
+			return (int)index;
+		}
+		_BitScanForward(&index, (unsigned long)(bits >> 32));
+		return (int)index + 32;
+	}
+#else
+	static int countTrailingZeros(unsigned long long bits)
+	{
+		return __builtin_ctzll(bits);
+	}
+#endif
+
+PumpBitmap::PumpBitmap(void)
+{
+	leaves = nullptr;
+	summary = nullptr;
+	leafCount = 0;
+	summaryCount = 0;
+	bitCount = 0;
+}
+
+PumpBitmap::~PumpBitmap(void)
+{
+	delete []leaves;
+	delete []summary;
+}
+
+void PumpBitmap::create(int numOfBits)
+{
+	delete []leaves;
+	delete []summary;
+
+	bitCount = numOfBits;
+	leafCount = (numOfBits + 63) / 64;
+	summaryCount = (leafCount + 63) / 64;
+	leaves = new atomic<unsigned long long>[leafCount];
+	summary = new atomic<unsigned long long>[summaryCount];
+
+	for (int i = 0; i < leafCount; i++)
+	{
+		leaves[i].store(0);
+	}
+
+	// pad the tail of the last leaf so the padding bits look like busy pumps
+	if ((numOfBits % 64) != 0)
+	{
+		leaves[leafCount - 1].store(allBits << (numOfBits % 64));
+	}
+
+	for (int i = 0; i < summaryCount; i++)
+	{
+		int leavesInWord = leafCount - (i * 64);
+		summary[i].store((leavesInWord >= 64) ? allBits : ((1ull << leavesInWord) - 1));
+	}
+}
+
+int PumpBitmap::claim(void)
+{
+	for (int s = 0; s < summaryCount; s++)
+	{
+		unsigned long long hint = summary[s].load();
+
+		while (hint != 0)
+		{
+			int leafIndex = (s * 64) + countTrailingZeros(hint);
+			atomic<unsigned long long>& leaf = leaves[leafIndex];
+			unsigned long long word = leaf.load();
+
+			// on failure word is reloaded with the current value and we try again
+			while (word != allBits)
+			{
+				int bit = countTrailingZeros(~word);
+				if (leaf.compare_exchange_weak(word, word | (1ull << bit)))
+				{
+					return (leafIndex * 64) + bit;
+				}
+			}
+
+			/////////////////////////////////////////////////////////////////////////////////////////////
+			//   The leaf is full so drop its summary bit. A release may have slipped in between our
+			//   last look at the leaf and clearing the bit, so look again after clearing it and put
+			//   the bit back if the leaf has a free pump. release clears the leaf before setting the
+			//   summary, so either it sees our clear or we see its free pump.
+			/////////////////////////////////////////////////////////////////////////////////////////////
+			unsigned long long leafBit = 1ull << (leafIndex % 64);
+			summary[s].fetch_and(~leafBit);
+			if (leaf.load() != allBits)
+			{
+				summary[s].fetch_or(leafBit);
+			}
+
+			hint &= ~leafBit;
+		}
+	}
+
+	return -1;
+}
+
+void PumpBitmap::release(int index)
+{
+	int leafIndex = index / 64;
+	unsigned long long leafBit = 1ull << (leafIndex % 64);
+	atomic<unsigned long long>& summaryWord = summary[leafIndex / 64];
+
+	leaves[leafIndex].fetch_and(~(1ull << (index % 64)));
+
+	// only write the summary when the bit is missing so releases don't bounce its cache line
+	if ((summaryWord.load() & leafBit) == 0)
+	{
+		summaryWord.fetch_or(leafBit);
+	}
+}
+
+bool PumpBitmap::isFull(void)
+{
+	for (int i = 0; i < leafCount; i++)
+	{
+		if (leaves[i].load() != allBits)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int PumpBitmap::getBitCount(void)
+{
+	return bitCount;
+}
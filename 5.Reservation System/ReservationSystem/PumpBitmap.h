@@ -0,0 +1,91 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  PumpBitmap.h
+// Job:   holds the PumpBitmap class 
+//////////////////////////////////////////////////////////////////////////////////
+
+// mult protection
+#ifndef _PUMPBITMAP_
+#define _PUMPBITMAP_
+
+// include needed files
+#include <atomic>
+
+// class PumpBitmap
+//
+// Two level bitmap used to hand out pumps without a lock. Every pump owns one bit
+// in a 64 bit leaf word (bit set = in use). Every leaf owns one bit in a summary 
+// word (bit set = that leaf still has a free pump), so finding a free pump is one 
+// scan of the summary plus one scan of a leaf, a single summary word covers 4096 pumps.
+class PumpBitmap
+{
+private:
+	//Variables
+	std::atomic<unsigned long long>* leaves;	// one bit per pump, set when the pump is in use
+	std::atomic<unsigned long long>* summary;	// one bit per leaf, set when the leaf has a free pump
+	int leafCount;								// number of words in leaves
+	int summaryCount;							// number of words in summary
+	int bitCount;								// number of pumps tracked by the bitmap
+
+	// disable copying, the bitmap owns its words
+	PumpBitmap(const PumpBitmap&);
+	PumpBitmap& operator=(const PumpBitmap&);
+
+public:
+	//constructor and destructor
+	PumpBitmap(void);
+	~PumpBitmap(void);
+
+	//accessors
+	int getBitCount(void);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		create
+	//
+	// Arguments:	numOfBits - number of pumps the bitmap tracks
+	//
+	// Notes:		This function will allocate the words with every pump free.
+	//				Bits past numOfBits in the last leaf start out in use so 
+	//				they can never be claimed
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void create(int numOfBits);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		claim
+	//
+	// Arguments:	none
+	//
+	// Notes:		This function will find the lowest free pump and set its 
+	//				bit with a compare and swap on the leaf
+	//
+	// Returns:		int - index of the claimed pump or (-1) if every pump is busy
+	//////////////////////////////////////////////////////////////////////
+	int claim(void);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		release
+	//
+	// Arguments:	index - index of a pump returned by claim
+	//
+	// Notes:		This function will clear the pump bit and mark its leaf
+	//				as having a free pump in the summary
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void release(int index);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		isFull
+	//
+	// Arguments:	none
+	//
+	// Notes:		This function will check the leaves themselves, the summary
+	//				is only a hint and can be briefly behind
+	//
+	// Returns:		bool - true if every pump is in use
+	//////////////////////////////////////////////////////////////////////
+	bool isFull(void);
+};
+
+#endif
@@ -0,0 +1,125 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  Simulation.cpp
+// Job:   holds the Simulation definitions 
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "Simulation.h"
+#include "Car.h"
+#include "Station.h"
+#include "Pump.h"
+
+using namespace std;
+
+Simulation::Simulation(Car* carsInTheTest, int maxCars, Station* stationToUse)
+{
+	cars = carsInTheTest;
+	carCount = maxCars;
+	station = stationToUse;
+	now = 0;
+	nextSequence = 0;
+	eventCount = 0;
+	parkCount = 0;
+	arrivedAt.resize(maxCars, 0);
+}
+
+Simulation::~Simulation(void)
+{
+}
+
+long long Simulation::getEventCount(void)
+{
+	return eventCount;
+}
+
+int Simulation::getParkCount(void)
+{
+	return parkCount;
+}
+
+void Simulation::schedule(long long delay, EventType type, int car, int pump)
+{
+	Event e;
+	e.time = now + delay;
+	e.sequence = nextSequence++;
+	e.type = type;
+	e.car = car;
+	e.pump = pump;
+	events.push(e);
+}
+
+void Simulation::startFill(int car, int pump)
+{
+	// counted when the fill starts, the threaded test also counts every fill that started before the end
+	cars[car].recordFill(now - arrivedAt[car]);
+	station->getPump(pump)->recordFill();
+	schedule(Pump::fillTimeInMs * 1000LL, EventType::FillDone, car, pump);
+}
+
+void Simulation::run(int timeInSecForTest)
+{
+	long long endOfTest = timeInSecForTest * 1000000LL;
+	long long restTime = station->getRestTimeInMs() * 1000LL;
+
+	// the gun goes off and every car pulls in at once
+	for (int i = 0; i < carCount; i++)
+	{
+		schedule(0, EventType::Arrive, i, -1);
+	}
+
+	while ((events.empty() == false) && (events.top().time < endOfTest))
+	{
+		Event e = events.top();
+		events.pop();
+		now = e.time;
+		eventCount++;
+
+		switch (e.type)
+		{
+		case EventType::Arrive:
+		{
+			/////////////////////////////////////////////////////////////////////////////////////////////
+			//   Same rules as Station::fillUp, in ticket mode nobody passes the line, otherwise take 
+			//   a free pump if there is one and get in line if there isn't.
+			/////////////////////////////////////////////////////////////////////////////////////////////
+			cars[e.car].recordTry();
+			arrivedAt[e.car] = now;
+
+			int pump = -1;
+			if ((station->getReservationMode() != ReservationMode::Ticket) || line.empty())
+			{
+				pump = station->claimPump();
+			}
+
+			if (pump == -1)
+			{
+				line.push_back(e.car);
+				parkCount++;
+			}
+			else
+			{
+				startFill(e.car, pump);
+			}
+			break;
+		}
+		case EventType::FillDone:
+		{
+			cars[e.car].recordService(Pump::fillTimeInMs * 1000LL);
+
+			// hand the pump to the oldest car in line, otherwise give it back to the station
+			if (line.empty() == false)
+			{
+				int oldest = line.front();
+				line.pop_front();
+				startFill(oldest, e.pump);
+			}
+			else
+			{
+				station->releasePump(e.pump);
+			}
+
+			schedule(restTime, EventType::Arrive, e.car, -1);
+			break;
+		}
+		}
+	}
+}
@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  Simulation.h
+// Job:   holds the Simulation class 
+//////////////////////////////////////////////////////////////////////////////////
+
+// mult protection
+#ifndef _SIMULATION_
+#define _SIMULATION_
+
+// include needed files
+#include <vector>
+#include <deque>
+#include <queue>
+
+// forward declarations
+class Car;
+class Station;
+
+// class Simulation
+//
+// Discrete event version of the test. Instead of a thread per car sleeping through
+// every fill, the cars, pumps and station are driven from one priority queue of 
+// events ordered by virtual time, so the same scenario runs as fast as one core can
+// pop events. All times are in virtual microseconds.
+class Simulation
+{
+private:
+	// the things that can happen to a car
+	enum class EventType
+	{
+		// the car pulls into the station and tries to get a pump
+		Arrive,
+		// the car is done filling at its pump
+		FillDone
+	};
+
+	// one scheduled event, sequence breaks ties so equal times run in the order they were scheduled
+	struct Event
+	{
+		long long time;
+		long long sequence;
+		EventType type;
+		int car;
+		int pump;
+
+		bool operator>(const Event& other) const
+		{
+			return (time != other.time) ? (time > other.time) : (sequence > other.sequence);
+		}
+	};
+
+	//Variables
+	Car* cars;												// array of cars in the test
+	int carCount;											// number of cars in the array
+	Station* station;										// station the cars fill up at
+	long long now;											// current virtual time
+	long long nextSequence;									// sequence number for the next event
+	long long eventCount;									// number of events processed
+	int parkCount;											// number of times a car had to get in line
+	std::priority_queue<Event, std::vector<Event>, std::greater<Event> > events;	// events that have not happened yet
+	std::deque<int> line;									// cars waiting for a pump, oldest first
+	std::vector<long long> arrivedAt;						// virtual time each car last pulled in
+
+	// puts an event on the queue to happen delay microseconds from now
+	void schedule(long long delay, EventType type, int car, int pump);
+
+	// the car has a pump, start filling
+	void startFill(int car, int pump);
+
+public:
+	//constructor and destructor
+	Simulation(Car* carsInTheTest, int maxCars, Station* stationToUse);
+	~Simulation(void);
+
+	//accessors
+	long long getEventCount(void);
+	int getParkCount(void);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		run
+	//
+	// Arguments:	timeInSecForTest - virtual length of the test
+	//
+	// Notes:		This function will start every car at time zero and 
+	//				process events until the virtual clock passes the end of
+	//				the test. Fills and tries are recorded in the same Car and
+	//				Pump counters the threaded test uses
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void run(int timeInSecForTest);
+};
+
+#endif
@@ -8,62 +8,212 @@
 
 using namespace std;
 
-Station::Station(void) : freeMask(0)
+Station::Station(void) : carsWaiting(0)
 {
 	pumps = nullptr;
 	pumpsInStation = 0;
+	lineHead = nullptr;
+	lineTail = nullptr;
+	waitersReleased = false;
+	parkCount = 0;
+	mode = ReservationMode::FirstFree;
+	stopCallback = nullptr;
 }
 
 Station::~Station(void)
 {
+	delete stopCallback;
 	delete []pumps;
 }
 
-int Station::fillUp()
+int Station::fillUp(chrono::steady_clock::time_point arrived, chrono::microseconds* waitTime, chrono::microseconds* serviceTime)
 {
 	/////////////////////////////////////////////////////////////////////////////////////////////
-	//   Find a free pump and fill up using that pump, otherwise wait until a pump becomes
-	//   available.
+	//   Find a free pump and fill up using that pump, otherwise wait in line until a pump is 
+	//   handed to us. Claiming and releasing a pump is lock free, the stationMutex only 
+	//   protects the line.
 	/////////////////////////////////////////////////////////////////////////////////////////////
 
-	bool success = false;
+	ParkingSlot slot;
+	bool parked;
 
-		for (int i = 0; i < this->pumpsInStation; i++)
+	int pumpIndex = this->reservePump(&slot, &parked);
+
+	//if fails wait in line for a pump to be handed to us 
+	if (parked == true)
+	{
+		pumpIndex = slot.park();
+	}
+
+	if (pumpIndex == -1)
+	{
+		*waitTime = chrono::microseconds(-1);
+		return 0;
+	}
+
+	chrono::steady_clock::time_point gotPump = chrono::steady_clock::now();
+	*waitTime = chrono::duration_cast<chrono::microseconds>(gotPump - arrived);
+
+	this->pumps[pumpIndex].fillTankUp();
+	this->releasePump(pumpIndex);
+
+	*serviceTime = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - gotPump);
+	return 1;
+}
+
+void Station::rest(void)
+{
+	// a stop cuts the rest short so the car can go home right away
+	this->stopToken.sleepFor(chrono::milliseconds(this->getRestTimeInMs()));
+}
+
+int Station::reservePump(ParkingSlot* slot, bool* parked)
+{
+	int pumpIndex = -1;
+	*parked = false;
+
+	// in ticket mode nobody gets to pass the cars already in line
+	if ((this->mode != ReservationMode::Ticket) || (this->carsWaiting.load() == 0))
+	{
+		pumpIndex = this->claimPump();
+	}
+
+	//if fails get in line 
+	if (pumpIndex == -1)
+	{
+		this->stationMutex->lock();
 		{
-			this->stationMutex->lock();
-			if ((this->freeMask & (1 << i)) == 0)
+			// announce ourselves before checking again, releasePump reads carsWaiting after 
+			// clearing its bit so one of us is guaranteed to see the other
+			this->carsWaiting++;
+			if ((this->mode != ReservationMode::Ticket) || (this->lineHead == nullptr))
 			{
-				this->freeMask |= (1 << i);
-				this->stationMutex->unlock();
-				success = true;
-				this->pumps[i].fillTankUp();
-
-				this->stationMutex->lock();
-				this->freeMask &= ~(1 << i);
-				
-				this->stationMutex->unlock();
-				this->stationCondition->notify_all();
-				break;
+				pumpIndex = this->claimPump();
+			}
+
+			if ((pumpIndex == -1) && (this->waitersReleased == false))
+			{
+				if (this->lineTail == nullptr)
+				{
+					this->lineHead = slot;
+				}
+				else
+				{
+					this->lineTail->setNext(slot);
+				}
+				this->lineTail = slot;
+				this->parkCount++;
+				*parked = true;
+			}
+			else
+			{
+				this->carsWaiting--;
 			}
-			this->stationMutex->unlock();
 		}
-		
+		this->stationMutex->unlock();
+	}
+
+	return pumpIndex;
+}
+
+int Station::claimPump(void)
+{
+	return this->freePumps.claim();
+}
+
+void Station::releasePump(int pumpIndex)
+{
+	// in ticket mode the pump goes straight to the oldest car without ever being free
+	if ((this->mode == ReservationMode::Ticket) && (this->carsWaiting.load() > 0))
+	{
+		ParkingSlot* oldest = nullptr;
+
+		this->stationMutex->lock();
+		{
+			oldest = this->popOldest();
+		}
+		this->stationMutex->unlock();
+
+		if (oldest != nullptr)
+		{
+			oldest->unpark(pumpIndex);
+			return;
+		}
+	}
+
+	this->freePumps.release(pumpIndex);
+
+	// only touch the line when someone is actually in it
+	if (this->carsWaiting.load() > 0)
+	{
+		ParkingSlot* oldest = nullptr;
+		int handedPump = -1;
 
-		//if fails wait 
-		if (success == false)
+		this->stationMutex->lock();
 		{
-			std::unique_lock<std::mutex> IamWaiting(*this->stationMutex);
+			/////////////////////////////////////////////////////////////////////////////////////////////
+			//   Take a pump back out for the oldest car. It may not be the one we just released if a
+			//   car that never parked grabbed it first, and if there is none left whoever holds it 
+			//   will hand it over when they release it.
+			/////////////////////////////////////////////////////////////////////////////////////////////
+			if (this->lineHead != nullptr)
+			{
+				handedPump = this->claimPump();
+				if (handedPump != -1)
+				{
+					oldest = this->popOldest();
+				}
+			}
+		}
+		this->stationMutex->unlock();
 
-			this->stationCondition->wait(IamWaiting);
-			//IamWaiting.unlock();
+		// exactly one car is woken and it already owns the pump
+		if (oldest != nullptr)
+		{
+			oldest->unpark(handedPump);
 		}
-		else
+	}
+}
+
+ParkingSlot* Station::popOldest(void)
+{
+	ParkingSlot* oldest = this->lineHead;
+
+	if (oldest != nullptr)
+	{
+		this->lineHead = oldest->getNext();
+		if (this->lineHead == nullptr)
 		{
-			this_thread::sleep_for(chrono::milliseconds(24 * (this->carsInStation /this->pumpsInStation)));
-			return 1;
+			this->lineTail = nullptr;
 		}
+		oldest->setNext(nullptr);
+		this->carsWaiting--;
+	}
 
-	return 0;
+	return oldest;
+}
+
+void Station::releaseWaiters(void)
+{
+	ParkingSlot* released;
+
+	this->stationMutex->lock();
+	{
+		this->waitersReleased = true;
+		released = this->lineHead;
+		this->lineHead = nullptr;
+		this->lineTail = nullptr;
+	}
+	this->stationMutex->unlock();
+
+	while (released != nullptr)
+	{
+		ParkingSlot* next = released->getNext();
+		released->setNext(nullptr);
+		this->carsWaiting--;
+		released->unpark(-1);
+		released = next;
+	}
 }
 
 int Station::getPumpFillCount(int num)
@@ -78,10 +228,22 @@ int Station::getPumpFillCount(int num)
 	}
 }
 
+Pump* Station::getPump(int num)
+{
+	return &pumps[num];
+}
+
+int Station::getRestTimeInMs(void)
+{
+	// the busier the station the longer a car stays away after filling up
+	return 24 * (this->carsInStation / this->pumpsInStation);
+}
+
 void Station::createPumps(int numOfPumps)
 {
 	pumps = new Pump[numOfPumps];
 	pumpsInStation = numOfPumps;
+	freePumps.create(numOfPumps);
 }
 
 int Station::getCarsInStation(void)
@@ -99,9 +261,24 @@ std::mutex* Station::getstationMutex(void)
 	return this->stationMutex;
 }
 
-std::condition_variable* Station::getStationCondition(void)
+int Station::getParkCount(void)
+{
+	return this->parkCount;
+}
+
+int Station::getPumpsInStation(void)
+{
+	return this->pumpsInStation;
+}
+
+int Station::getLineLength(void)
 {
-	return this->stationCondition;
+	return this->carsWaiting.load();
+}
+
+bool Station::hasFreePump(void)
+{
+	return (this->freePumps.isFull() == false);
 }
 
 void Station::setStationMutex(std::mutex* m)
@@ -109,7 +286,20 @@ void Station::setStationMutex(std::mutex* m)
 	this->stationMutex = m;
 }
 
-void Station::setStationCondition(std::condition_variable* cv)
+ReservationMode Station::getReservationMode(void)
+{
+	return this->mode;
+}
+
+void Station::setReservationMode(ReservationMode m)
 {
-	this->stationCondition = cv;
+	this->mode = m;
+}
+
+void Station::setStopToken(const StopToken& token)
+{
+	delete this->stopCallback;
+
+	this->stopToken = token;
+	this->stopCallback = new StopCallback(token, [this](){ this->releaseWaiters(); });
 }
@@ -11,21 +11,47 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+#include "PumpBitmap.h"
+#include "ParkingSlot.h"
+#include "StopToken.h"
 
 // forward declarations
 class Pump;
 
+// how a freed pump is given out when cars are waiting in line
+enum class ReservationMode
+{
+	// the first car to find the free pump gets it, cars that never parked can take it before the line
+	FirstFree,
+	// every car that arrives while the line is not empty joins it, a finishing car hands its pump 
+	// straight to the oldest car in line so cars are served strictly in arrival order
+	Ticket
+};
+
 // class Station
 class Station
 {
 private:
 	//Variables
-	unsigned int freeMask;						// used for seeing if a pump is in use or not 
+	PumpBitmap freePumps;						// used for seeing if a pump is in use or not 
+	std::atomic<int> carsWaiting;				// number of cars in (or about to join) the line
+	ParkingSlot* lineHead;						// oldest car parked in the line
+	ParkingSlot* lineTail;						// newest car parked in the line
+	bool waitersReleased;						// set once the line has been emptied for the end of the test
+	int parkCount;								// number of times a car had to park
+	ReservationMode mode;						// how pumps are given to cars in line
 	Pump *pumps;								// an array of pumps 
 	int pumpsInStation;							// number of pumps in the station
 	int carsInStation;							// number of cars that will visit the station
-	std::mutex* stationMutex;					// mutex for protecting memory in the station
-	std::condition_variable* stationCondition;	// cv used for scheduling in the station
+	std::mutex* stationMutex;					// mutex for protecting the line in the station
+	StopToken stopToken;						// token that ends the test
+	StopCallback* stopCallback;					// releases the line when the test ends
+
+	// removes the oldest car from the line, the stationMutex must be held
+	ParkingSlot* popOldest(void);
 
 public:
 	//constructor and destructor
@@ -34,26 +60,103 @@ public:
 
 	//accessors  
 	int getPumpFillCount(int num);
+	Pump* getPump(int num);
+	int getRestTimeInMs(void);
 	int getCarsInStation(void);
+	int getParkCount(void);
+	int getPumpsInStation(void);
+	int getLineLength(void);
+	bool hasFreePump(void);
+	ReservationMode getReservationMode(void);
 	std::mutex* getstationMutex(void);
-	std::condition_variable* getStationCondition(void);
 
 	// mutators
 	void setCarsInStation(int num);
 	void setStationMutex(std::mutex* m);
-	void setStationCondition(std::condition_variable* cv);	
+	void setReservationMode(ReservationMode m);
+	void setStopToken(const StopToken& token);
 	
 	///////////////////////////////////////////////////////////////////////
 	// Name:		fillUp
 	//
-	// Arguments:	none
+	// Arguments:	arrived - when the car pulled in, the wait is counted from here
+	//				waitTime - set to the time spent getting a pump, or (-1) 
+	//				if the car never got one
+	//				serviceTime - set to the time spent at the pump
 	//
 	// Notes:		This function will be the reservation system.  It will 
-	//				fill up the gas tanks of cars and control thier access 
+	//				fill up the gas tanks of cars and control thier access.
+	//				When every pump is busy the car parks in a first in first
+	//				out line and a finishing car hands its pump to the oldest
+	//				car in line
+	//
+	// Returns:		int - (1) if the fill up was successfull and (0) if it failed
+	//////////////////////////////////////////////////////////////////////
+	int fillUp(std::chrono::steady_clock::time_point arrived, std::chrono::microseconds* waitTime, std::chrono::microseconds* serviceTime);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		rest
+	//
+	// Arguments:	void
+	//
+	// Notes:		This function will sleep the time a car stays away between
+	//				fills, cut short when the test ends
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void rest(void);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		reservePump
+	//
+	// Arguments:	slot - parking slot to put in line if every pump is busy
+	//				parked - set to true if the slot was put in line
+	//
+	// Notes:		This function will claim a free pump or put the slot in
+	//				line without blocking. A parked slot is unparked later 
+	//				with the pump handed to it, or (-1) if the line was released
+	//
+	// Returns:		int - index of the claimed pump or (-1) if there was none
+	//////////////////////////////////////////////////////////////////////
+	int reservePump(ParkingSlot* slot, bool* parked);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		claimPump
+	//
+	// Arguments:	none
+	//
+	// Notes:		This function will find the lowest free pump and mark it 
+	//				as in use in the freePumps bitmap. It never takes the 
+	//				stationMutex
+	//
+	// Returns:		int - index of the claimed pump or (-1) if every pump is busy
+	//////////////////////////////////////////////////////////////////////
+	int claimPump(void);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		releasePump
 	//
-	// Returns:		int - (1) if the fill up was successfull and (-1) if it failed
+	// Arguments:	pumpIndex - index of the pump returned by claimPump
+	//
+	// Notes:		This function will clear the pump bit in the freePumps bitmap
+	//				and, only if cars are in line, hand a pump to the oldest one
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void releasePump(int pumpIndex);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		releaseWaiters
+	//
+	// Arguments:	void
+	//
+	// Notes:		This function will wake every car in line without a pump
+	//				and stop new cars from parking, run by the stop callback
+	//				when the test ends
+	//
+	// Returns:		void
 	//////////////////////////////////////////////////////////////////////
-	int fillUp();
+	void releaseWaiters(void);
 	
 	///////////////////////////////////////////////////////////////////////
 	// Name:		createPumps
@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  StationNetwork.cpp
+// Job:   holds the StationNetwork definitions 
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "StationNetwork.h"
+
+using namespace std;
+
+// xorshift step, plenty for picking neighbours and it keeps the car's state in one int
+static unsigned int nextRandom(unsigned int* seed)
+{
+	unsigned int x = *seed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*seed = x;
+	return x;
+}
+
+StationNetwork::StationNetwork(void) : stealCount(0)
+{
+	stations = nullptr;
+	stationMutexes = nullptr;
+	stationCount = 0;
+}
+
+StationNetwork::~StationNetwork(void)
+{
+	delete []stations;
+	delete []stationMutexes;
+}
+
+void StationNetwork::createStations(int numOfStations, int pumpsPerStation, int carsPerStation, ReservationMode mode)
+{
+	stations = new Station[numOfStations];
+	stationMutexes = new mutex[numOfStations];
+	stationCount = numOfStations;
+
+	for (int i = 0; i < numOfStations; i++)
+	{
+		stations[i].createPumps(pumpsPerStation);
+		stations[i].setCarsInStation(carsPerStation);
+		stations[i].setStationMutex(&stationMutexes[i]);
+		stations[i].setReservationMode(mode);
+	}
+}
+
+Station* StationNetwork::pickStation(Station* home, unsigned int* seed)
+{
+	if ((stationCount == 1) || (home->hasFreePump() == true))
+	{
+		return home;
+	}
+
+	Station* first = &stations[nextRandom(seed) % stationCount];
+	Station* second = &stations[nextRandom(seed) % stationCount];
+	Station* best = (first->getLineLength() <= second->getLineLength()) ? first : second;
+
+	// a free pump beats any line, otherwise only leave home for a shorter line
+	if ((best != home) && ((best->hasFreePump() == true) || (best->getLineLength() < home->getLineLength())))
+	{
+		stealCount++;
+		return best;
+	}
+
+	return home;
+}
+
+void StationNetwork::setStopToken(const StopToken& token)
+{
+	for (int i = 0; i < stationCount; i++)
+	{
+		stations[i].setStopToken(token);
+	}
+}
+
+Station* StationNetwork::getStation(int num)
+{
+	return &stations[num];
+}
+
+int StationNetwork::getStationCount(void)
+{
+	return stationCount;
+}
+
+int StationNetwork::getStealCount(void)
+{
+	return stealCount.load();
+}
+
+int StationNetwork::getParkCount(void)
+{
+	int parks = 0;
+	for (int i = 0; i < stationCount; i++)
+	{
+		parks += stations[i].getParkCount();
+	}
+	return parks;
+}
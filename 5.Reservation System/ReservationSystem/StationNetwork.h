@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  StationNetwork.h
+// Job:   holds the StationNetwork class 
+//////////////////////////////////////////////////////////////////////////////////
+
+// mult protection
+#ifndef _STATIONNETWORK_
+#define _STATIONNETWORK_
+
+// include needed files
+#include <mutex>
+#include <atomic>
+
+#include "Station.h"
+
+// class StationNetwork
+//
+// A group of stations, each with its own pumps and line. Every car has a home
+// station, when every pump at home is busy the car looks at two other stations 
+// picked at random and goes to the one with the shorter line if it is shorter 
+// than the line at home (power of two choices).
+class StationNetwork
+{
+private:
+	//Variables
+	Station* stations;						// an array of stations
+	std::mutex* stationMutexes;				// one mutex per station for its line
+	int stationCount;						// number of stations in the network
+	std::atomic<int> stealCount;			// number of fills a car took away from home
+
+	// disable copying, the network owns its stations
+	StationNetwork(const StationNetwork&);
+	StationNetwork& operator=(const StationNetwork&);
+
+public:
+	//constructor and destructor
+	StationNetwork(void);
+	~StationNetwork(void);
+
+	//accessors
+	Station* getStation(int num);
+	int getStationCount(void);
+	int getStealCount(void);
+	int getParkCount(void);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		createStations
+	//
+	// Arguments:	numOfStations - number of stations in the network
+	//				pumpsPerStation - number of pumps at every station
+	//				carsPerStation - number of cars that call each station home
+	//				mode - how every station gives out its pumps
+	//
+	// Notes:		This function will allocate the stations and their pumps 
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void createStations(int numOfStations, int pumpsPerStation, int carsPerStation, ReservationMode mode);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		pickStation
+	//
+	// Arguments:	home - the car's home station
+	//				seed - the car's random state, updated on every call
+	//
+	// Notes:		This function will return home while it has a free pump, 
+	//				otherwise the less loaded of home and two random neighbours
+	//
+	// Returns:		Station* - station the car should fill up at
+	//////////////////////////////////////////////////////////////////////
+	Station* pickStation(Station* home, unsigned int* seed);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		setStopToken
+	//
+	// Arguments:	token - token that ends the test
+	//
+	// Notes:		This function will hand the token to every station so a 
+	//				stop releases every line
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void setStopToken(const StopToken& token);
+};
+
+#endif
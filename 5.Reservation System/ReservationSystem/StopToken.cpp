@@ -0,0 +1,160 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  StopToken.cpp
+// Job:   holds the StopSource, StopToken and StopCallback definitions 
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "StopToken.h"
+
+using namespace std;
+
+StopToken::StopToken(void)
+{
+}
+
+StopToken::~StopToken(void)
+{
+}
+
+bool StopToken::stopRequested(void) const
+{
+	return (state != nullptr) && (state->stopped.load() == true);
+}
+
+bool StopToken::sleepFor(chrono::milliseconds duration) const
+{
+	if (state == nullptr)
+	{
+		this_thread::sleep_for(duration);
+		return false;
+	}
+
+	unique_lock<mutex> IamSleeping(state->stateMutex);
+	StopState* s = state.get();
+
+	return state->stateCondition.wait_for(IamSleeping, duration, [s](){ return s->stopped.load(); });
+}
+
+StopSource::StopSource(void) : state(make_shared<StopState>())
+{
+}
+
+StopSource::~StopSource(void)
+{
+}
+
+StopToken StopSource::getToken(void)
+{
+	StopToken token;
+	token.state = state;
+	return token;
+}
+
+bool StopSource::stopRequested(void)
+{
+	return state->stopped.load();
+}
+
+bool StopSource::requestStop(void)
+{
+	unique_lock<mutex> locked(state->stateMutex);
+
+	if (state->stopped.load() == true)
+	{
+		return false;
+	}
+
+	state->stopped = true;
+	state->runningThread = this_thread::get_id();
+	state->stateCondition.notify_all();
+
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	//   Run the callbacks one at a time without holding the mutex, so a callback can take
+	//   any lock it likes. Each is unlinked first so its destructor knows it is running.
+	/////////////////////////////////////////////////////////////////////////////////////////////
+	while (state->callbacks != nullptr)
+	{
+		StopCallback* current = state->callbacks;
+		state->callbacks = current->next;
+		if (state->callbacks != nullptr)
+		{
+			state->callbacks->prev = nullptr;
+		}
+		current->registered = false;
+		state->running = current;
+
+		locked.unlock();
+		current->callback();
+		locked.lock();
+
+		state->running = nullptr;
+		state->stateCondition.notify_all();
+	}
+
+	return true;
+}
+
+StopCallback::StopCallback(const StopToken& token, function<void()> onStop) : state(token.state), callback(onStop)
+{
+	next = nullptr;
+	prev = nullptr;
+	registered = false;
+
+	if (state == nullptr)
+	{
+		return;
+	}
+
+	state->stateMutex.lock();
+	if (state->stopped.load() == false)
+	{
+		next = state->callbacks;
+		if (next != nullptr)
+		{
+			next->prev = this;
+		}
+		state->callbacks = this;
+		registered = true;
+	}
+	state->stateMutex.unlock();
+
+	// the stop already happened so there is nothing to wait for
+	if (registered == false)
+	{
+		callback();
+	}
+}
+
+StopCallback::~StopCallback(void)
+{
+	if (state == nullptr)
+	{
+		return;
+	}
+
+	unique_lock<mutex> locked(state->stateMutex);
+
+	if (registered == true)
+	{
+		if (prev != nullptr)
+		{
+			prev->next = next;
+		}
+		else
+		{
+			state->callbacks = next;
+		}
+		if (next != nullptr)
+		{
+			next->prev = prev;
+		}
+		registered = false;
+	}
+	else
+	{
+		// requestStop is running us on another thread, wait for it to finish
+		while ((state->running == this) && (state->runningThread != this_thread::get_id()))
+		{
+			state->stateCondition.wait(locked);
+		}
+	}
+}
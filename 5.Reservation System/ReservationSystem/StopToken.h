@@ -0,0 +1,131 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  StopToken.h
+// Job:   holds the StopSource, StopToken and StopCallback classes 
+//////////////////////////////////////////////////////////////////////////////////
+
+// mult protection
+#ifndef _STOPTOKEN_
+#define _STOPTOKEN_
+
+// include needed files
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <functional>
+
+// forward declarations
+class StopCallback;
+
+// struct StopState
+//
+// The state shared by a StopSource and every token and callback made from it.
+struct StopState
+{
+	std::atomic<bool> stopped;					// set once a stop has been requested
+	std::mutex stateMutex;						// mutex for protecting the callback list
+	std::condition_variable stateCondition;		// cv sleeping tokens and unregistering callbacks wait on
+	StopCallback* callbacks;					// callbacks still to run, newest first
+	StopCallback* running;						// callback being run by requestStop, if any
+	std::thread::id runningThread;				// thread running the callbacks
+
+	StopState(void) : stopped(false), callbacks(nullptr), running(nullptr) {}
+};
+
+// class StopToken
+//
+// Cheap to copy handle used to ask whether a stop has been requested, and to sleep
+// in a way a stop request cuts short.
+class StopToken
+{
+private:
+	friend class StopSource;
+	friend class StopCallback;
+
+	//Variables
+	std::shared_ptr<StopState> state;			// state shared with the source, null for a token that never stops
+
+public:
+	//constructor and destructor
+	StopToken(void);
+	~StopToken(void);
+
+	//accessors
+	bool stopRequested(void) const;
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		sleepFor
+	//
+	// Arguments:	duration - how long to sleep
+	//
+	// Notes:		This function will sleep like this_thread::sleep_for but 
+	//				returns as soon as a stop is requested
+	//
+	// Returns:		bool - true if the sleep was cut short by a stop
+	//////////////////////////////////////////////////////////////////////
+	bool sleepFor(std::chrono::milliseconds duration) const;
+};
+
+// class StopSource
+//
+// Owner of the stop state, the one place a stop is requested from.
+class StopSource
+{
+private:
+	//Variables
+	std::shared_ptr<StopState> state;			// state shared with every token
+
+public:
+	//constructor and destructor
+	StopSource(void);
+	~StopSource(void);
+
+	//accessors
+	StopToken getToken(void);
+	bool stopRequested(void);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		requestStop
+	//
+	// Arguments:	void
+	//
+	// Notes:		This function will set the stop, wake every sleeping token 
+	//				and run every registered callback on the calling thread
+	//
+	// Returns:		bool - true if this call made the stop, false if it was 
+	//				already requested
+	//////////////////////////////////////////////////////////////////////
+	bool requestStop(void);
+};
+
+// class StopCallback
+//
+// Runs a function when a stop is requested while the callback is registered, or
+// right away if the stop already happened. Destroying the callback unregisters it
+// and waits if requestStop is running it on another thread, so whatever the 
+// callback touches can be destroyed right after.
+class StopCallback
+{
+private:
+	friend class StopSource;
+
+	//Variables
+	std::shared_ptr<StopState> state;			// state the callback is registered with
+	std::function<void()> callback;				// function to run on stop
+	StopCallback* next;							// next callback in the list
+	StopCallback* prev;							// previous callback in the list
+	bool registered;							// true while the callback is in the list
+
+	// disable copying, the list points at the callback
+	StopCallback(const StopCallback&);
+	StopCallback& operator=(const StopCallback&);
+
+public:
+	//constructor and destructor
+	StopCallback(const StopToken& token, std::function<void()> onStop);
+	~StopCallback(void);
+};
+
+#endif
@@ -0,0 +1,197 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  TaskScheduler.cpp
+// Job:   holds the TaskScheduler definitions 
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "TaskScheduler.h"
+
+using namespace std;
+
+TaskScheduler::TaskScheduler(void)
+{
+	nextSequence = 0;
+	shuttingDown = false;
+	stopCallback = nullptr;
+	liveTasks = 0;
+}
+
+TaskScheduler::~TaskScheduler(void)
+{
+	waitForTasks();
+	delete stopCallback;
+}
+
+void TaskScheduler::start(int workerCount)
+{
+	if (workerCount <= 0)
+	{
+		workerCount = (int)thread::hardware_concurrency();
+		if (workerCount <= 0)
+		{
+			workerCount = 1;
+		}
+	}
+
+	for (int i = 0; i < workerCount; i++)
+	{
+		workers.push_back(new thread(&TaskScheduler::workerLoop, this));
+	}
+}
+
+void TaskScheduler::workerLoop(void)
+{
+	unique_lock<mutex> locked(schedulerMutex);
+
+	while (true)
+	{
+		// wake every task whose timer has run out
+		chrono::steady_clock::time_point now = chrono::steady_clock::now();
+		while ((timers.empty() == false) && (timers.top().deadline <= now))
+		{
+			ready.push_back(timers.top().task);
+			timers.pop();
+		}
+
+		if (ready.empty() == false)
+		{
+			Task* task = ready.front();
+			ready.pop_front();
+
+			locked.unlock();
+			task->run();
+			locked.lock();
+			continue;
+		}
+
+		if (shuttingDown == true)
+		{
+			break;
+		}
+
+		// nothing to run, sleep until there is work or the next timer is due
+		if (timers.empty() == true)
+		{
+			workCondition.wait(locked);
+		}
+		else
+		{
+			workCondition.wait_until(locked, timers.top().deadline);
+		}
+	}
+}
+
+void TaskScheduler::spawn(Task* task)
+{
+	schedulerMutex.lock();
+	{
+		liveTasks++;
+		ready.push_back(task);
+	}
+	schedulerMutex.unlock();
+	workCondition.notify_one();
+}
+
+void TaskScheduler::submit(Task* task)
+{
+	schedulerMutex.lock();
+	{
+		ready.push_back(task);
+	}
+	schedulerMutex.unlock();
+	workCondition.notify_one();
+}
+
+void TaskScheduler::submitAfter(Task* task, chrono::milliseconds delay)
+{
+	bool isEarliest;
+
+	schedulerMutex.lock();
+	{
+		Timer timer;
+		timer.deadline = chrono::steady_clock::now() + delay;
+		timer.sequence = nextSequence++;
+		timer.task = task;
+
+		// during the stop sleeping tasks are run right away so they can finish
+		if (stopToken.stopRequested() == true)
+		{
+			timer.deadline = chrono::steady_clock::now();
+		}
+
+		isEarliest = timers.empty() || (timer.deadline < timers.top().deadline);
+		timers.push(timer);
+	}
+	schedulerMutex.unlock();
+
+	// only a new earliest deadline changes how long the idle workers should sleep
+	if (isEarliest == true)
+	{
+		workCondition.notify_one();
+	}
+}
+
+void TaskScheduler::finish(void)
+{
+	schedulerMutex.lock();
+	{
+		liveTasks--;
+		if (liveTasks == 0)
+		{
+			doneCondition.notify_all();
+		}
+	}
+	schedulerMutex.unlock();
+}
+
+void TaskScheduler::setStopToken(const StopToken& token)
+{
+	delete stopCallback;
+
+	stopToken = token;
+	stopCallback = new StopCallback(token, [this](){ this->wakeSleepers(); });
+}
+
+void TaskScheduler::wakeSleepers(void)
+{
+	schedulerMutex.lock();
+	{
+		// move every sleeping task to the back of the line
+		while (timers.empty() == false)
+		{
+			ready.push_back(timers.top().task);
+			timers.pop();
+		}
+	}
+	schedulerMutex.unlock();
+	workCondition.notify_all();
+}
+
+void TaskScheduler::waitForTasks(void)
+{
+	unique_lock<mutex> locked(schedulerMutex);
+	while (liveTasks != 0)
+	{
+		doneCondition.wait(locked);
+	}
+
+	shuttingDown = true;
+	locked.unlock();
+	workCondition.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i]->join();
+		delete workers[i];
+	}
+	workers.clear();
+}
+
+int TaskScheduler::getWorkerCount(void)
+{
+	return (int)workers.size();
+}
+
+bool TaskScheduler::isStopRequested(void)
+{
+	return stopToken.stopRequested();
+}
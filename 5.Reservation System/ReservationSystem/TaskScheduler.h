@@ -0,0 +1,183 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  TaskScheduler.h
+// Job:   holds the Task and TaskScheduler classes 
+//////////////////////////////////////////////////////////////////////////////////
+
+// mult protection
+#ifndef _TASKSCHEDULER_
+#define _TASKSCHEDULER_
+
+// include needed files
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <deque>
+#include <queue>
+
+#include "StopToken.h"
+
+// class Task
+//
+// A piece of work that runs a step at a time on the scheduler's worker threads.
+// Instead of blocking, a task that has to wait hands itself to whoever will wake it
+// (a timer or a parking slot) and returns from run.
+class Task
+{
+public:
+	virtual ~Task(void) {}
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		run
+	//
+	// Arguments:	void
+	//
+	// Notes:		This function will run the next step of the task. Once the
+	//				task has been handed to something that resubmits it, it 
+	//				may already be running on another worker, so that must be
+	//				the last thing run does
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	virtual void run(void) = 0;
+};
+
+// class TaskScheduler
+//
+// Runs any number of tasks on a fixed pool of worker threads. Tasks are either ready
+// to run or sleeping on a timer, so memory and thread count grow with the workers,
+// not with the tasks.
+class TaskScheduler
+{
+private:
+	// a task sleeping until its deadline, sequence keeps equal deadlines in order
+	struct Timer
+	{
+		std::chrono::steady_clock::time_point deadline;
+		long long sequence;
+		Task* task;
+
+		bool operator>(const Timer& other) const
+		{
+			return (deadline != other.deadline) ? (deadline > other.deadline) : (sequence > other.sequence);
+		}
+	};
+
+	//Variables
+	std::vector<std::thread*> workers;							// the worker threads
+	std::deque<Task*> ready;									// tasks waiting for a worker
+	std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer> > timers;	// sleeping tasks, earliest first
+	long long nextSequence;										// sequence number for the next timer
+	bool shuttingDown;											// set to make the workers exit
+	StopToken stopToken;										// token that tells the tasks to wrap up
+	StopCallback* stopCallback;									// wakes the sleeping tasks on a stop
+	int liveTasks;												// tasks started and not yet finished
+	std::mutex schedulerMutex;									// mutex for protecting the queues and counts
+	std::condition_variable workCondition;						// cv the idle workers wait on
+	std::condition_variable doneCondition;						// cv used to wait for liveTasks to reach 0
+
+	// disable copying, the workers point back at the scheduler
+	TaskScheduler(const TaskScheduler&);
+	TaskScheduler& operator=(const TaskScheduler&);
+
+	// the loop each worker thread runs
+	void workerLoop(void);
+
+	// moves every sleeping task to the ready queue, run by the stop callback
+	void wakeSleepers(void);
+
+public:
+	//constructor and destructor
+	TaskScheduler(void);
+	~TaskScheduler(void);
+
+	//accessors
+	int getWorkerCount(void);
+	bool isStopRequested(void);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		start
+	//
+	// Arguments:	workerCount - number of worker threads, (0) for one per core
+	//
+	// Notes:		This function will start the worker threads
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void start(int workerCount);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		spawn
+	//
+	// Arguments:	task - task to start
+	//
+	// Notes:		This function will count the task as live and make it ready,
+	//				it is live until it calls finish
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void spawn(Task* task);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		submit
+	//
+	// Arguments:	task - live task to run again
+	//
+	// Notes:		This function will put the task on the ready queue
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void submit(Task* task);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		submitAfter
+	//
+	// Arguments:	task - live task to run again
+	//				delay - how long the task sleeps first
+	//
+	// Notes:		This function will put the task to sleep without holding 
+	//				a thread
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void submitAfter(Task* task, std::chrono::milliseconds delay);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		finish
+	//
+	// Arguments:	void
+	//
+	// Notes:		This function will be called by a task as its last step
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void finish(void);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		setStopToken
+	//
+	// Arguments:	token - token that tells the tasks to wrap up
+	//
+	// Notes:		This function will register a callback so a stop wakes 
+	//				every sleeping task and they see it right away
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void setStopToken(const StopToken& token);
+
+	///////////////////////////////////////////////////////////////////////
+	// Name:		waitForTasks
+	//
+	// Arguments:	void
+	//
+	// Notes:		This function will block until every spawned task has 
+	//				finished, then stop and join the workers
+	//
+	// Returns:		void
+	//////////////////////////////////////////////////////////////////////
+	void waitForTasks(void);
+};
+
+#endif
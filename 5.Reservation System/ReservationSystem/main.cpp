@@ -12,6 +12,17 @@
 
 #include "Car.h"
 #include "Station.h"
+#include "Pump.h"
+#include "StationNetwork.h"
+#include "Benchmark.h"
+#include "Simulation.h"
+#include "TaskScheduler.h"
+#include "CarTask.h"
+#include "CarCounters.h"
+#include "StopToken.h"
+#include "ArrivalQueue.h"
+#include "Histogram.h"
+#include "../../Common/FastRand.h"
 
 #include <iostream>  
 #include <vector>
@@ -19,6 +30,9 @@
 #include <random>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
 
 using namespace std;
 
@@ -34,6 +48,28 @@ using namespace std;
 	#define ENABLE_LEAK_DETECTION()
 #endif
 
+// Include the process wide context switch counter and peak memory (KB) where the platform has cheap ones
+#if defined _WIN32
+	#define CONTEXT_SWITCHES() (-1L)
+	#define PEAK_MEMORY_KB() (-1L)
+#else
+	#include <sys/resource.h>
+	static long contextSwitches(void)
+	{
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		return usage.ru_nvcsw + usage.ru_nivcsw;
+	}
+	static long peakMemoryKB(void)
+	{
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		return usage.ru_maxrss;
+	}
+	#define CONTEXT_SWITCHES() contextSwitches()
+	#define PEAK_MEMORY_KB() peakMemoryKB()
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////////
 // Name:		pause
 //
@@ -71,13 +107,342 @@ void testACar(Car* car)
 	}
 	gunUnique.unlock();
 
-	// run test until flag is set
-	while((*(car->getTestOver())) == false)
+	// run test until the stop is requested
+	while(car->getStopToken().stopRequested() == false)
 	{
 		car->fillTank();
 	}
 }
 
+///////////////////////////////////////////////////////////////////////////////////
+// Name:		driveArrivals
+//
+// Arguments:	Car* - the pointer to the memory of a car that is in this test
+//
+// Note:		the car is a driver for the open loop test, it takes the oldest 
+//				arrival and fills up for it until the test is over
+//
+// Returns:		void
+///////////////////////////////////////////////////////////////////////////////////
+void driveArrivals(Car* car)
+{
+	chrono::steady_clock::time_point due;
+
+	while(car->getArrivals()->pop(&due) == true)
+	{
+		car->driveArrival(due);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Name:		printFairness
+//
+// Arguments:	cars	- array of the cars in the test
+//				maxCars - number of cars in the array
+//
+// Note:		prints Jain's fairness index over the fill counts, 1.0 when every car
+//				filled the same number of times down to 1/maxCars when one car did 
+//				all of the filling
+//
+// Returns:		void
+///////////////////////////////////////////////////////////////////////////////////
+void printFairness(Car* cars, int maxCars)
+{
+	double sum = 0.0;
+	double sumOfSquares = 0.0;
+
+	for(int i = 0; i < maxCars; i++)
+	{
+		double fills = cars[i].getFillCount();
+		sum += fills;
+		sumOfSquares += fills * fills;
+	}
+
+	if(sumOfSquares > 0.0)
+	{
+		cout << "Jain's fairness index " << ((sum * sum) / (maxCars * sumOfSquares)) << endl;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Name:		printLatency
+//
+// Arguments:	waits		- queueing delay of every fill in microseconds
+//				services	- time at the pump of every fill in microseconds
+//				csvName		- file the percentile table is also written to
+//
+// Note:		prints a percentile table of the queueing delay and service time
+//				in ms and writes the same table in microseconds as csv
+//
+// Returns:		void
+///////////////////////////////////////////////////////////////////////////////////
+void printLatency(const Histogram& waits, const Histogram& services, const char* csvName)
+{
+	static const double percentiles[] = { 0.0, 10.0, 20.0, 30.0, 40.0, 50.0, 60.0, 70.0, 80.0, 90.0, 
+		95.0, 97.5, 99.0, 99.5, 99.9, 99.95, 99.99, 100.0 };
+	static const int percentileCount = sizeof(percentiles) / sizeof(percentiles[0]);
+
+	if(waits.getCount() == 0)
+	{
+		return;
+	}
+
+	cout << "Latency (ms) over " << waits.getCount() << " fills" << endl;
+	cout << "  percentile    queueing     service" << endl;
+	for(int i = 0; i < percentileCount; i++)
+	{
+		printf("  %10.2f %11.3f %11.3f\n", percentiles[i], 
+			waits.valueAtPercentile(percentiles[i]) / 1000.0, services.valueAtPercentile(percentiles[i]) / 1000.0);
+	}
+	printf("  %10s %11.3f %11.3f\n", "mean", waits.getMean() / 1000.0, services.getMean() / 1000.0);
+
+	ofstream csv(csvName);
+	if(csv.is_open() == false)
+	{
+		cout << "Could not write " << csvName << endl;
+		return;
+	}
+
+	csv << "percentile,queueing_us,service_us" << endl;
+	for(int i = 0; i < percentileCount; i++)
+	{
+		csv << percentiles[i] << "," << waits.valueAtPercentile(percentiles[i]) << "," << services.valueAtPercentile(percentiles[i]) << endl;
+	}
+	cout << "Percentiles written to " << csvName << endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Name:		printShutdown
+//
+// Arguments:	stopAt	- when the stop was requested
+//
+// Note:		prints how long it took every car to stop, it should stay under one
+//				fill time since only cars already at a pump have anything left to do
+//
+// Returns:		void
+///////////////////////////////////////////////////////////////////////////////////
+void printShutdown(chrono::steady_clock::time_point stopAt)
+{
+	chrono::duration<double, milli> shutdown = chrono::steady_clock::now() - stopAt;
+	cout << "All cars stopped " << shutdown.count() << " ms after the stop request (one fill takes " << Pump::fillTimeInMs << " ms)" << endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Name:		runThreadedTest
+//
+// Arguments:	carsInTheTest		- array of the cars in the test
+//				maxCars				- number of cars in the array
+//				network				- stations the cars fill up at
+//				timeInSecForTest	- length of the test in seconds
+//
+// Note:		runs the test on a thread per car in real time
+//
+// Returns:		long				- context switches during the test or (-1) if unknown
+///////////////////////////////////////////////////////////////////////////////////
+long runThreadedTest(Car* carsInTheTest, int maxCars, StationNetwork& network, int timeInSecForTest)
+{
+	// creates all variables need for the test of the reservation system
+	// needed:
+	//				1 stop source
+	//				1 int
+	//				2 mutex
+	//				2 condition variables
+	StopSource testOver;
+	int numberStandingInLine = 0;
+	std::mutex countMutex;
+	std::mutex gunMutex;
+	condition_variable gunCondition;
+	condition_variable countCondition;
+	
+	// set all variables into there respected classes
+	network.setStopToken(testOver.getToken());
+	for(int i = 0; i < maxCars; i++)
+	{
+		carsInTheTest[i].setNumberStandingInLine(&numberStandingInLine);
+		carsInTheTest[i].setCountMutex(&countMutex);
+		carsInTheTest[i].setCountCondition(&countCondition);
+		carsInTheTest[i].setGunMutex(&gunMutex);
+		carsInTheTest[i].setGunCondition(&gunCondition);
+		carsInTheTest[i].setStopToken(testOver.getToken());
+		carsInTheTest[i].startCar(testACar);
+	}
+
+	// waiting till everyone is at the starting line
+	unique_lock<mutex> countUnique(countMutex);
+	{
+		while(numberStandingInLine != maxCars)
+		{
+			countCondition.wait(countUnique);
+		}
+	}
+	countUnique.unlock();
+
+	long switchesAtStart = CONTEXT_SWITCHES();
+
+	// shoot the gun
+	gunMutex.lock();
+	{
+		gunCondition.notify_all();
+	}
+	gunMutex.unlock();
+
+	//pause for the length of the test
+	this_thread::sleep_for(chrono::seconds(timeInSecForTest));
+
+	//Test in now over so start the ending sequence, the stop sends the cars in line home 
+	//and cuts the resting cars short so only cars at a pump finish their fill
+	chrono::steady_clock::time_point stopAt = chrono::steady_clock::now();
+	testOver.requestStop();
+
+	for(int i = 0; i < maxCars; i++)
+	{
+		carsInTheTest[i].waitForCarToStop();
+	}
+
+	printShutdown(stopAt);
+
+	if(switchesAtStart < 0)
+	{
+		return -1;
+	}
+	return CONTEXT_SWITCHES() - switchesAtStart;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Name:		runOpenLoopTest
+//
+// Arguments:	carsInTheTest		- array of the cars in the test, used as drivers
+//				maxCars				- number of cars in the array
+//				network				- stations the cars fill up at
+//				timeInSecForTest	- length of the test in seconds
+//				arrivalsPerSec		- mean rate cars arrive at
+//				poisson				- true for Poisson arrivals, false for a fixed rate
+//
+// Note:		runs the test in real time with cars arriving on a schedule no matter
+//				how the station keeps up, main generates the arrivals and every car
+//				thread drives the oldest one that is due
+//
+// Returns:		long				- context switches during the test or (-1) if unknown
+///////////////////////////////////////////////////////////////////////////////////
+long runOpenLoopTest(Car* carsInTheTest, int maxCars, StationNetwork& network, int timeInSecForTest, double arrivalsPerSec, bool poisson)
+{
+	StopSource testOver;
+	ArrivalQueue arrivals;
+	FastRand generator(12345);
+	exponential_distribution<double> poissonGap(arrivalsPerSec);
+	long arrivalCount = 0;
+
+	network.setStopToken(testOver.getToken());
+	arrivals.setStopToken(testOver.getToken());
+	for(int i = 0; i < maxCars; i++)
+	{
+		carsInTheTest[i].setArrivals(&arrivals);
+		carsInTheTest[i].setStopToken(testOver.getToken());
+		carsInTheTest[i].startCar(driveArrivals);
+	}
+
+	long switchesAtStart = CONTEXT_SWITCHES();
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	chrono::steady_clock::time_point endOfTest = start + chrono::seconds(timeInSecForTest);
+	double secondsToNext = 0.0;
+
+	// each arrival is due a set time after the last one was due, not after it was pushed,
+	// so a late wake up here never thins out the arrivals
+	while(true)
+	{
+		secondsToNext += (poisson == true) ? poissonGap(generator) : (1.0 / arrivalsPerSec);
+		chrono::steady_clock::time_point due = start + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(secondsToNext));
+		if(due >= endOfTest)
+		{
+			break;
+		}
+
+		this_thread::sleep_until(due);
+		arrivals.push(due);
+		arrivalCount++;
+	}
+	this_thread::sleep_until(endOfTest);
+
+	cout << "Generated " << arrivalCount << " arrivals, " << arrivals.getBacklog() << " still waiting for a driver at the end, ";
+	cout << "longest backlog " << arrivals.getLongestBacklog() << endl;
+
+	chrono::steady_clock::time_point stopAt = chrono::steady_clock::now();
+	testOver.requestStop();
+
+	for(int i = 0; i < maxCars; i++)
+	{
+		carsInTheTest[i].waitForCarToStop();
+	}
+
+	printShutdown(stopAt);
+
+	if(switchesAtStart < 0)
+	{
+		return -1;
+	}
+	return CONTEXT_SWITCHES() - switchesAtStart;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// Name:		runTaskTest
+//
+// Arguments:	carsInTheTest		- array of the cars in the test
+//				maxCars				- number of cars in the array
+//				network				- stations the cars fill up at
+//				timeInSecForTest	- length of the test in seconds
+//
+// Note:		runs the test in real time with every car as a task on one worker
+//				thread per core, waiting cars hold no thread
+//
+// Returns:		long				- context switches during the test or (-1) if unknown
+///////////////////////////////////////////////////////////////////////////////////
+long runTaskTest(Car* carsInTheTest, int maxCars, StationNetwork& network, int timeInSecForTest)
+{
+	TaskScheduler scheduler;
+	StopSource testOver;
+	CarTask *tasksInTheTest = new CarTask[maxCars];
+
+	network.setStopToken(testOver.getToken());
+	scheduler.setStopToken(testOver.getToken());
+
+	for(int i = 0; i < maxCars; i++)
+	{
+		tasksInTheTest[i].setCar(&carsInTheTest[i]);
+		tasksInTheTest[i].setScheduler(&scheduler);
+	}
+
+	long switchesAtStart = CONTEXT_SWITCHES();
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	// the tasks are the starting line, spawning them shoots the gun
+	scheduler.start(0);
+	for(int i = 0; i < maxCars; i++)
+	{
+		scheduler.spawn(&tasksInTheTest[i]);
+	}
+
+	chrono::duration<double, milli> startup = chrono::steady_clock::now() - start;
+	cout << "Started " << maxCars << " car tasks on " << scheduler.getWorkerCount() << " workers in " << startup.count() << " ms" << endl;
+
+	//pause for the length of the test
+	this_thread::sleep_for(chrono::seconds(timeInSecForTest));
+
+	//Test in now over, wake the resting cars and send the ones in line home
+	chrono::steady_clock::time_point stopAt = chrono::steady_clock::now();
+	testOver.requestStop();
+	scheduler.waitForTasks();
+
+	printShutdown(stopAt);
+
+	delete []tasksInTheTest;
+
+	if(switchesAtStart < 0)
+	{
+		return -1;
+	}
+	return CONTEXT_SWITCHES() - switchesAtStart;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////
 // Name:		main
 //
@@ -97,9 +462,24 @@ int main(int argc, char**argv)
 	int maxCars = 0;
 	int maxPumps = 0;
 	int timeInSecForTest = 0;
+	int maxStations = 1;
+	ReservationMode mode = ReservationMode::FirstFree;
+	bool simulate = false;
+	bool useTasks = false;
+	double arrivalsPerSec = 0.0;
+	bool poisson = true;
 	
+	// run the micro benchmarks instead of the test
+	if((argc == 2) && (strcmp(argv[1], "bench") == 0))
+	{
+		benchmarkPumpClaims();
+		benchmarkCounters();
+		pause();
+		return 0;
+	}
+
 	// read in command line args or use defaults provided
-	if(argc != 4)
+	if((argc < 4) || (argc > 9))
 	{
 		maxCars = 10;
 		maxPumps = 2;
@@ -128,98 +508,190 @@ int main(int argc, char**argv)
 			cout << "timeInSecForTest <= 0, exiting" << endl;
 			exit(-1);
 		}
-	}
 
-	cout << "Running Gas Station, using " << maxCars << " cars, using " << maxPumps << " pumps" << endl;
-	
-	// creates all variables need for the test of the reservation system
-	// needed:
-	//				1 bool
-	//				1 int
-	//				3 mutex
-	//				3 condition variables
-	//				1 Station
-	//				the Station will make our pumps
-	//				(max) cars
+		if(argc >= 5)
+		{
+			if(strcmp(argv[4], "ticket") == 0)
+			{
+				mode = ReservationMode::Ticket;
+			}
+			else if(strcmp(argv[4], "first") != 0)
+			{
+				cout << "Mode must be first or ticket, exiting" << endl;
+				exit(-1);
+			}
+		}
 
-	bool testOver;
-	int numberStandingInLine = 0;
-	std::mutex countMutex;
-	std::mutex gunMutex;
-	condition_variable gunCondition;
-	condition_variable countCondition;
-	Station stationToUse;
-	std::mutex stationMutex;
-	condition_variable stationCondition;
-	Car *carsInTheTest = new Car[maxCars];
-	
-	// set all variables into there respected classes
-	stationToUse.createPumps(maxPumps);
-	stationToUse.setCarsInStation(maxCars);
-	stationToUse.setStationMutex(&stationMutex);
-	stationToUse.setStationCondition(&stationCondition);
+		if(argc >= 6)
+		{
+			if(strcmp(argv[5], "sim") == 0)
+			{
+				simulate = true;
+			}
+			else if(strcmp(argv[5], "tasks") == 0)
+			{
+				useTasks = true;
+			}
+			else if(strcmp(argv[5], "threads") != 0)
+			{
+				cout << "Engine must be threads, tasks or sim, exiting" << endl;
+				exit(-1);
+			}
+		}
 
-	for(int i = 0; i < maxCars; i++)
-	{
-		carsInTheTest[i].setStationToUse(&stationToUse);
-		carsInTheTest[i].setNumberStandingInLine(&numberStandingInLine);
-		carsInTheTest[i].setCountMutex(&countMutex);
-		carsInTheTest[i].setCountCondition(&countCondition);
-		carsInTheTest[i].setGunMutex(&gunMutex);
-		carsInTheTest[i].setGunCondition(&gunCondition);
-		carsInTheTest[i].setTestOver(&testOver);
-		carsInTheTest[i].startCar(testACar);
-	}
+		if(argc >= 7)
+		{
+			maxStations = atoi(argv[6]);
 
-	// waiting till everyone is at the starting line
-	unique_lock<mutex> countUnique(countMutex);
-	{
-		while(numberStandingInLine != maxCars)
+			if(maxStations <= 0)
+			{
+				cout << "Station count <= 0, exiting" << endl;
+				exit(-1);
+			}
+
+			if((maxStations > 1) && (simulate == true))
+			{
+				cout << "The simulation runs a single station, exiting" << endl;
+				exit(-1);
+			}
+		}
+
+		if(argc >= 8)
 		{
-			countCondition.wait(countUnique);
+			arrivalsPerSec = atof(argv[7]);
+
+			if(arrivalsPerSec < 0.0)
+			{
+				cout << "Arrivals per second < 0, exiting" << endl;
+				exit(-1);
+			}
+
+			if((arrivalsPerSec > 0.0) && ((simulate == true) || (useTasks == true)))
+			{
+				cout << "Open loop arrivals run on the threads engine, exiting" << endl;
+				exit(-1);
+			}
+		}
+
+		if(argc == 9)
+		{
+			if(strcmp(argv[8], "fixed") == 0)
+			{
+				poisson = false;
+			}
+			else if(strcmp(argv[8], "poisson") != 0)
+			{
+				cout << "Arrivals must be poisson or fixed, exiting" << endl;
+				exit(-1);
+			}
 		}
 	}
-	countUnique.unlock();
 
-	// shoot the gun
-	gunMutex.lock();
+	cout << "Running " << maxStations << " Gas Station(s), using " << maxCars << " cars, using " << maxPumps << " pumps per station, ";
+	cout << ((mode == ReservationMode::Ticket) ? "ticket" : "first free") << " mode, ";
+	cout << ((simulate == true) ? "simulated" : ((useTasks == true) ? "tasks" : "threaded")) << endl;
+	if(arrivalsPerSec > 0.0)
 	{
-		testOver = false;
-		gunCondition.notify_all();
+		// a pump serves one car per fill time, utilisation is the share of that the arrivals ask for
+		double offered = (arrivalsPerSec * Pump::fillTimeInMs / 1000.0) / (maxPumps * maxStations);
+		cout << "Open loop, " << ((poisson == true) ? "Poisson" : "fixed rate") << " arrivals at " << arrivalsPerSec;
+		cout << " per second, offered utilisation " << (offered * 100.0) << "%" << endl;
 	}
-	gunMutex.unlock();
+	
+	// the stations and cars are shared by every way of running the test, each car calls 
+	// one station home and spreads to the others when home is busy
+	StationNetwork network;
+	CounterSlots carCounters;
+	Car *carsInTheTest = new Car[maxCars];
+	long switchesInTest = -1;
+	int parkCount = 0;
 
-	//pause for the length of the test
-	this_thread::sleep_for(chrono::seconds(timeInSecForTest));
+	network.createStations(maxStations, maxPumps, (maxCars + maxStations - 1) / maxStations, mode);
+	carCounters.create(maxCars);
 
-	//Test in now over so start the ending sequence
-	stationMutex.lock();
+	for(int i = 0; i < maxCars; i++)
 	{
-		testOver = true;
-		stationCondition.notify_all();
+		carsInTheTest[i].setCounters(carCounters.getSlot(i));
+		carsInTheTest[i].setStationToUse(network.getStation(i % maxStations));
+		carsInTheTest[i].setNetwork(&network, (unsigned int)(i + 1) * 2654435761u);
 	}
-	stationMutex.unlock();
 
-	for(int i = 0; i < maxCars; i++)
+	if(simulate == true)
 	{
-		carsInTheTest[i].waitForCarToStop();
+		Simulation simulation(carsInTheTest, maxCars, network.getStation(0));
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		simulation.run(timeInSecForTest);
+		chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+		cout << "Simulated " << simulation.getEventCount() << " events in " << elapsed.count() << " seconds, ";
+		cout << (simulation.getEventCount() / elapsed.count()) << " events per second" << endl;
+		parkCount = simulation.getParkCount();
+	}
+	else if(arrivalsPerSec > 0.0)
+	{
+		switchesInTest = runOpenLoopTest(carsInTheTest, maxCars, network, timeInSecForTest, arrivalsPerSec, poisson);
+		parkCount = network.getParkCount();
+	}
+	else if(useTasks == true)
+	{
+		switchesInTest = runTaskTest(carsInTheTest, maxCars, network, timeInSecForTest);
+		parkCount = network.getParkCount();
+	}
+	else
+	{
+		switchesInTest = runThreadedTest(carsInTheTest, maxCars, network, timeInSecForTest);
+		parkCount = network.getParkCount();
 	}
 	
 	//print all result for the cars and pumps at the station
+	int totalFills = 0;
 	cout << "Cars:" << endl;
 	for(int i = 0; i < maxCars; i++)
 	{
 		cout << "  car # " << i << ", Fill count " << carsInTheTest[i].getFillCount(); 
 		cout << ", Try count " << carsInTheTest[i].getTryCount() << endl;
+		totalFills += carsInTheTest[i].getFillCount();
+	}
+
+	for(int s = 0; s < maxStations; s++)
+	{
+		cout << "Station " << s << ":" << endl;
+
+		for(int i = 0; i < maxPumps; i++)
+		{
+			cout << "  Pump " << i << ", Fill count " << network.getStation(s)->getPumpFillCount(i) << endl;
+		}
 	}
 
-	cout << "Station:" << endl;
+	cout << "Total fills " << totalFills << ", " << ((double)totalFills / timeInSecForTest) << " fills per second" << endl;
+	if((switchesInTest >= 0) && (totalFills > 0))
+	{
+		cout << "Context switches " << switchesInTest << ", " << ((double)switchesInTest / totalFills) << " per fill" << endl;
+	}
+	cout << "Cars parked in line " << parkCount << " times" << endl;
+	if(maxStations > 1)
+	{
+		cout << "Cars filled away from home " << network.getStealCount() << " times" << endl;
+	}
+	if(PEAK_MEMORY_KB() >= 0)
+	{
+		cout << "Peak memory " << PEAK_MEMORY_KB() << " KB" << endl;
+	}
+	printFairness(carsInTheTest, maxCars);
 
-	for(int i = 0; i < maxPumps; i++)
+	Histogram waits;
+	Histogram services;
+	for(int i = 0; i < maxCars; i++)
 	{
-		cout << "  Pump " << i << ", Fill count " << stationToUse.getPumpFillCount(i) << endl;
+		waits.add(carsInTheTest[i].getWaitTimes());
+		services.add(carsInTheTest[i].getServiceTimes());
 	}
 
+	double busyTime = (services.getMean() * services.getCount()) / 1000000.0;
+	cout << "Measured pump utilisation " << ((busyTime / (timeInSecForTest * maxPumps * maxStations)) * 100.0) << "%" << endl;
+	printLatency(waits, services, "latency.csv");
+
 	// clean up our memory
 	delete []carsInTheTest;
 
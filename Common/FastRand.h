@@ -0,0 +1,166 @@
+///////////////////////////////////////////////////////////////////////////////////
+// file:  FastRand.h
+// Job:   holds the FastRand random number generator shared by every project
+//////////////////////////////////////////////////////////////////////////////////
+
+// mult protection
+#ifndef _FASTRAND_
+#define _FASTRAND_
+
+// include needed files
+#include <random>
+
+// Visual Studio 2013 has no constexpr, the engine limits only need it for <random>
+#if defined _MSC_VER && _MSC_VER < 1900
+	#define FASTRAND_CONSTEXPR
+#else
+	#define FASTRAND_CONSTEXPR constexpr
+#endif
+
+// class FastRand
+//
+// xoshiro256** generator. The whole state is 32 bytes, so one can sit in every thread's
+// struct without the kilobytes of a mt19937, and a draw is a handful of shifts and adds.
+// Bounded values use Lemire's multiply and shift, which has no modulo bias and only 
+// divides in the rare case a draw has to be thrown away. Seeding only runs splitmix64,
+// so thousands of generators can be seeded from one std::random_device value instead 
+// of asking the device once per object. Meets the standard engine requirements, so it
+// can also drive the <random> distributions.
+class FastRand
+{
+public:
+	typedef unsigned long long result_type;
+
+	static FASTRAND_CONSTEXPR result_type min() { return 0; }
+	static FASTRAND_CONSTEXPR result_type max() { return ~0ULL; }
+
+	FastRand(void)
+	{
+		Seed(0);
+	}
+
+	explicit FastRand(unsigned long long seed)
+	{
+		Seed(seed);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////
+	// Spreads a 64 bit seed over the whole state with splitmix64, which never leaves
+	//   the state all zero. Close seeds still give unrelated streams.
+	//
+	// Arguments:
+	//   seed - any value, the same seed always gives the same stream
+	///////////////////////////////////////////////////////////////////////////////////
+	void Seed(unsigned long long seed)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			seed += 0x9E3779B97F4A7C15ULL;
+			unsigned long long mixed = seed;
+			mixed = (mixed ^ (mixed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			mixed = (mixed ^ (mixed >> 27)) * 0x94D049BB133111EBULL;
+			state[i] = mixed ^ (mixed >> 31);
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////
+	// Returns the next 64 random bits
+	///////////////////////////////////////////////////////////////////////////////////
+	result_type operator()()
+	{
+		unsigned long long result = RotateLeft(state[1] * 5, 7) * 9;
+		unsigned long long shifted = state[1] << 17;
+
+		state[2] ^= state[0];
+		state[3] ^= state[1];
+		state[1] ^= state[2];
+		state[0] ^= state[3];
+		state[2] ^= shifted;
+		state[3] = RotateLeft(state[3], 45);
+
+		return result;
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////
+	// Returns a value in [0, range) with every value equally likely.
+	//
+	// Arguments:
+	//   range - number of possible values, must be at least 1
+	///////////////////////////////////////////////////////////////////////////////////
+	unsigned int Bounded(unsigned int range)
+	{
+		return BoundedFrom((unsigned int)((*this)() >> 32), range);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////
+	// Returns a value in [min, max] (inclusive) with every value equally likely.
+	///////////////////////////////////////////////////////////////////////////////////
+	int Range(int min, int max)
+	{
+		return min + (int)Bounded((unsigned int)(max - min) + 1);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////
+	// Fills an array with values in [0, range). Each 64 bit draw is split into two 
+	//   32 bit halves, so a batch costs half the generator steps of calling Bounded.
+	//
+	// Arguments:
+	//   range - number of possible values, must be at least 1
+	//   values - array to fill
+	//   count - number of entries in values
+	///////////////////////////////////////////////////////////////////////////////////
+	void Fill(unsigned int range, unsigned int *values, int count)
+	{
+		int i = 0;
+		for (; i + 1 < count; i += 2)
+		{
+			unsigned long long bits = (*this)();
+			values[i] = BoundedFrom((unsigned int)(bits >> 32), range);
+			values[i + 1] = BoundedFrom((unsigned int)bits, range);
+		}
+		if (i < count)
+		{
+			values[i] = Bounded(range);
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////
+	// Asks std::random_device for one 64 bit seed. Meant to be called once at start up
+	//   to seed a single generator that then hands out seeds for all the others.
+	///////////////////////////////////////////////////////////////////////////////////
+	static unsigned long long DeviceSeed(void)
+	{
+		std::random_device randDevice;
+		unsigned long long high = randDevice();
+		return (high << 32) ^ randDevice();
+	}
+
+private:
+	unsigned long long state[4];
+
+	static unsigned long long RotateLeft(unsigned long long bits, int count)
+	{
+		return (bits << count) | (bits >> (64 - count));
+	}
+
+	// Lemire's method, the high half of bits * range is the answer unless bits landed 
+	//   in the few values that would make some answers more likely, then draw again
+	unsigned int BoundedFrom(unsigned int bits, unsigned int range)
+	{
+		unsigned long long product = (unsigned long long)bits * range;
+		unsigned int low = (unsigned int)product;
+		if (low < range)
+		{
+			unsigned int threshold = (0u - range) % range;
+			while (low < threshold)
+			{
+				bits = (unsigned int)((*this)() >> 32);
+				product = (unsigned long long)bits * range;
+				low = (unsigned int)product;
+			}
+		}
+		return (unsigned int)(product >> 32);
+	}
+};
+
+#endif